@@ -0,0 +1,492 @@
+// -*- C++ -*-
+/*!
+ * @file RobotisLDSensorBench.cpp
+ * @brief Microbenchmarks of the scan hot paths
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Usage: RobotisLDSensorBench [-n scans] [capture file]
+ *
+ * Replays the recorded byte stream (or a synthetic one) from memory and
+ * reports, for each hot path of the component, the time and the number
+ * of heap allocations per scan:
+ *   poll:       frame sync, validation and decode, LDSensor::poll()
+ *   legacy:     per beam offset and modulo loop over a polled scan, as
+ *               onExecute used to do
+ *   copy:       the same with a RotationPlan, two bulk scaled copies
+ *   rotate:     decode rotated and scaled by the plan straight into the
+ *               RangeData buffer, onExecute
+ *   fill:       RangeData sequence sizing plus rotate, onExecute
+ *   filter:     all scan filters in place on the RangeData buffer
+ *   points:     conversion of the RangeData to points in the robot frame
+ *   bins:       2 degree min and 5 degree nearest binning of the RangeData
+ *   grid:       occupancy grid update and image copy, 160 x 160 cells
+ *   odometry:   scan matching of the revolution against itself turned
+ *               by 2 degrees, alternately
+ *   quantise:   RangeData ranges to CompactScan millimetres
+ *   compact:    delta coding of the millimetre ranges, alternately with
+ *               +-8 mm of noise, and the resulting bytes per scan
+ *   expand:     decoding of the same scans
+ *   shared:     RangeData ranges into the shared memory ring, onExecute
+ *   fetch:      copy of the latest scan out of the ring, by a reader
+ *   marshal:    CDR serialization of the RangeData, as OutPort::write()
+ */
+
+#include <HLDS_Capture.h>
+#include <HLDS_CompactScan.h>
+#include <HLDS_LDSensor.h>
+#include <HLDS_OccupancyGrid.h>
+#include <HLDS_PointCloud.h>
+#include <HLDS_ScanBinning.h>
+#include <HLDS_ScanFilter.h>
+#include <HLDS_ScanMatcher.h>
+#include <HLDS_SharedScan.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+
+namespace
+{
+std::atomic<uint64_t> g_allocations(0);
+}
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) { throw std::bad_alloc(); }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+
+namespace
+{
+
+/*
+ * Loops over the chunks of a recorded stream, keeping the original read
+ * boundaries.
+ */
+class MemorySource : public HLDS::ByteSource
+{
+public:
+    MemorySource(const std::vector<uint8_t>& bytes,
+                 const std::vector<size_t>& chunks)
+      : m_bytes(bytes), m_chunks(chunks), m_chunk(0), m_offset(0), m_used(0)
+    {
+    }
+
+    virtual size_t read(uint8_t* buffer, size_t length)
+    {
+        size_t n = std::min(length, m_chunks[m_chunk] - m_used);
+        memcpy(buffer, &m_bytes[m_offset], n);
+        m_offset += n;
+        m_used += n;
+        if (m_used == m_chunks[m_chunk])
+        {
+            m_used = 0;
+            if (++m_chunk == m_chunks.size()) { m_chunk = 0; m_offset = 0; }
+        }
+        return n;
+    }
+
+    virtual void write(const uint8_t*, size_t) {}
+
+private:
+    const std::vector<uint8_t>& m_bytes;
+    const std::vector<size_t>& m_chunks;
+    size_t m_chunk;
+    size_t m_offset;
+    size_t m_used;
+};
+
+void loadCapture(const char* path, std::vector<uint8_t>& bytes,
+                 std::vector<size_t>& chunks)
+{
+    HLDS::ReplaySource replay(path, 0.0);
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = replay.read(buffer, sizeof(buffer))) > 0)
+    {
+        bytes.insert(bytes.end(), buffer, buffer + n);
+        chunks.push_back(n);
+    }
+}
+
+// Ten revolutions of valid packets, in 64 byte reads
+void synthesize(std::vector<uint8_t>& bytes, std::vector<size_t>& chunks)
+{
+    uint32_t seed = 1;
+    for (int frame = 0; frame < 10; ++frame)
+    {
+        for (uint16_t n = 0; n < HLDS::PacketCount; ++n)
+        {
+            uint8_t packet[HLDS::PacketLength];
+            for (size_t i = 0; i < sizeof(packet); ++i)
+            {
+                seed = seed * 1664525 + 1013904223;
+                packet[i] = uint8_t(seed >> 24);
+            }
+            packet[0] = 0xFA;
+            packet[1] = uint8_t(0xA0 + n);
+            HLDS::writeChecksum(packet);
+            bytes.insert(bytes.end(), packet, packet + sizeof(packet));
+        }
+    }
+    for (size_t i = 0; i < bytes.size(); i += 64)
+    {
+        chunks.push_back(std::min(bytes.size() - i, size_t(64)));
+    }
+}
+
+class Timer
+{
+public:
+    Timer(const char* name, size_t scans)
+      : m_name(name), m_scans(scans),
+        m_allocations(g_allocations.load(std::memory_order_relaxed)),
+        m_start(std::chrono::steady_clock::now())
+    {
+    }
+    ~Timer()
+    {
+        double ns = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - m_start).count();
+        uint64_t allocations =
+            g_allocations.load(std::memory_order_relaxed) - m_allocations;
+        std::cout << std::left << std::setw(10) << m_name << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << ns / m_scans << " ns/scan"
+                  << std::setw(10) << std::setprecision(2)
+                  << double(allocations) / m_scans << " allocs/scan"
+                  << std::endl;
+    }
+
+private:
+    const char* m_name;
+    size_t m_scans;
+    uint64_t m_allocations;
+    std::chrono::steady_clock::time_point m_start;
+};
+}
+
+int main(int argc, char** argv)
+{
+    size_t scans = 10000;
+    const char* capture = NULL;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            scans = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            capture = argv[i];
+        }
+    }
+    if (scans == 0)
+    {
+        std::cerr << "usage: " << argv[0] << " [-n scans] [capture file]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<size_t> chunks;
+    try
+    {
+        if (capture != NULL) { loadCapture(capture, bytes, chunks); }
+        else { synthesize(bytes, chunks); }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (bytes.size() < HLDS::FrameLength)
+    {
+        std::cerr << "capture holds no complete frame" << std::endl;
+        return 1;
+    }
+    std::cout << "input:    " << (capture ? capture : "synthetic") << ", "
+              << bytes.size() << " bytes, " << chunks.size() << " reads"
+              << std::endl;
+    std::cout << "kernel:   " << HLDS::decodeKernel() << std::endl;
+    std::cout << "filters:  " << HLDS::filterKernel() << std::endl;
+    std::cout << "points:   " << HLDS::pointKernel() << std::endl;
+
+    HLDS::LDSensor sensor(new MemorySource(bytes, chunks));
+    HLDS::LaserScan scan;
+    sensor.poll(scan);
+    {
+        Timer timer("poll", scans);
+        for (size_t i = 0; i < scans; ++i) { sensor.poll(scan); }
+    }
+
+    HLDS::RawFrame frame;
+    sensor.readFrame(frame);
+    const size_t count = HLDS::BeamCount;
+    const float incr = 2.0 * M_PI / count;
+    // Configuration parameters, read from memory like the members of the
+    // component
+    volatile double offset = 5.0;
+    volatile float scale = 1.0;
+    const HLDS::RotationPlan plan =
+        HLDS::makeRotationPlan(offset / 180 * M_PI, incr, scale);
+
+    RTC::RangeData range;
+    range.ranges.length(count);
+    {
+        // The loop onExecute used to run over a polled scan: the offset
+        // division and a modulo for every beam
+        Timer timer("legacy", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            for (size_t b = 0; b < count; ++b)
+            {
+                int i_d = (b + count - int((offset / 180 * M_PI) / incr))
+                          % count;
+                range.ranges[b] = scan.ranges[i_d] * scale;
+            }
+        }
+    }
+    {
+        Timer timer("copy", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            HLDS::rotateScan(&scan.ranges[0], range.ranges.get_buffer(), plan);
+        }
+    }
+    {
+        Timer timer("rotate", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            HLDS::ScanSpan<CORBA::Double> out = {
+                range.ranges.get_buffer(), NULL, plan.scale, plan.shift
+            };
+            HLDS::decodeFrame(frame, out);
+        }
+    }
+    {
+        Timer timer("fill", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            range.ranges.length(count);
+            HLDS::ScanSpan<CORBA::Double> out = {
+                range.ranges.get_buffer(), NULL, plan.scale, plan.shift
+            };
+            HLDS::decodeFrame(frame, out);
+        }
+    }
+    {
+        // Every filter enabled, the shadow filter with the widest window
+        double intensities[HLDS::BeamCount];
+        HLDS::ScanSpan<CORBA::Double> out = {
+            range.ranges.get_buffer(), intensities, plan.scale, plan.shift
+        };
+        HLDS::decodeFrame(frame, out);
+        const HLDS::ScanFilterPlan filters = HLDS::makeScanFilterPlan(
+            100.0, 5, 10.0 / 180 * M_PI, HLDS::MaxShadowWindow, 0.05, incr);
+        Timer timer("filter", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            HLDS::filterScan(filters, range.ranges.get_buffer(), intensities);
+        }
+    }
+    {
+        // A tilted mount, every coordinate is computed
+        HLDS::ScanSpan<CORBA::Double> out = {
+            range.ranges.get_buffer(), NULL, plan.scale, plan.shift
+        };
+        HLDS::decodeFrame(frame, out);
+        const HLDS::MountTransform mount = HLDS::makeMountTransform(
+            0.1, 0.0, 0.2, 0.05, -0.1, M_PI / 2);
+        HLDS::PointScan points;
+        Timer timer("points", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            HLDS::scanToPoints(mount, range.ranges.get_buffer(), points);
+        }
+    }
+    {
+        const HLDS::BinPlan fine = HLDS::makeBinPlan(2, HLDS::BinMin);
+        const HLDS::BinPlan coarse = HLDS::makeBinPlan(5, HLDS::BinNearest);
+        double bins[HLDS::BeamCount];
+        Timer timer("bins", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            HLDS::binScan(fine, range.ranges.get_buffer(), bins);
+            HLDS::binScan(coarse, range.ranges.get_buffer(), bins);
+        }
+    }
+    {
+        HLDS::OccupancyGrid grid;
+        grid.configure(160, 0.05);
+        std::vector<uint8_t> pixels(grid.size() * grid.size());
+        HLDS::ScanSpan<CORBA::Double> out = {
+            range.ranges.get_buffer(), NULL, plan.scale, plan.shift
+        };
+        HLDS::decodeFrame(frame, out);
+        Timer timer("grid", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            grid.update(range.ranges.get_buffer());
+            memcpy(&pixels[0], grid.image(), pixels.size());
+        }
+    }
+    {
+        double turned[2][HLDS::BeamCount];
+        for (size_t k = 0; k < 2; ++k)
+        {
+            HLDS::ScanSpan<double> out = {
+                turned[k], NULL, plan.scale, (plan.shift + 2 * k) % count
+            };
+            HLDS::decodeFrame(frame, out);
+        }
+        HLDS::ScanMatcher matcher;
+        HLDS::Motion2D motion;
+        Timer timer("odometry", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            matcher.match(turned[i % 2], motion);
+        }
+    }
+    {
+        HLDS::ScanSpan<CORBA::Double> out = {
+            range.ranges.get_buffer(), NULL, plan.scale, plan.shift
+        };
+        HLDS::decodeFrame(frame, out);
+        uint16_t mm[2][HLDS::BeamCount];
+        {
+            Timer timer("quantise", scans);
+            for (size_t i = 0; i < scans; ++i)
+            {
+                HLDS::quantiseRanges(range.ranges.get_buffer(), count, mm[0]);
+            }
+        }
+        uint32_t seed = 0x2545F491;
+        for (size_t b = 0; b < count; ++b)
+        {
+            seed = seed * 1664525 + 1013904223;
+            mm[1][b] = mm[0][b] == 0 ? 0 :
+                       uint16_t(mm[0][b] + (seed >> 28) - 8);
+        }
+
+        const size_t encoded = 2 * HLDS::maxDeltaBytes(count);
+        std::vector<uint8_t> data(scans * encoded);
+        std::vector<uint32_t> lengths(scans), seqs(scans), references(scans);
+        HLDS::CompactEncoder encoder;
+        {
+            Timer timer("compact", scans);
+            for (size_t i = 0; i < scans; ++i)
+            {
+                lengths[i] = uint32_t(encoder.encode(mm[i % 2], NULL,
+                                                     &data[i * encoded],
+                                                     seqs[i], references[i]));
+            }
+        }
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < scans; ++i) { bytes += lengths[i]; }
+        std::cout << "coded:    " << double(bytes) / scans
+                  << " bytes/scan, RangeData ranges "
+                  << count * sizeof(CORBA::Double) << std::endl;
+
+        HLDS::CompactDecoder decoder;
+        uint16_t decoded[HLDS::BeamCount];
+        Timer timer("expand", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            decoder.decode(seqs[i], references[i], &data[i * encoded],
+                           lengths[i], false, decoded, NULL);
+        }
+    }
+    {
+        // A private segment, removed again afterwards
+        const std::string name("/RobotisLDSensorBench");
+        HLDS::SharedScanWriter writer;
+        writer.open(name, 4);
+        HLDS::SharedScanReader reader;
+        reader.open(name);
+        {
+            Timer timer("shared", scans);
+            for (size_t i = 0; i < scans; ++i)
+            {
+                HLDS::SharedScan& shared = writer.beginWrite();
+                shared.minAngle = range.config.minAngle;
+                shared.angularRes = range.config.angularRes;
+                shared.beams = uint32_t(count);
+                shared.hasIntensities = 0;
+                memcpy(shared.ranges, range.ranges.get_buffer(),
+                       count * sizeof(double));
+                writer.publish();
+            }
+        }
+        HLDS::SharedScan latest;
+        {
+            Timer timer("fetch", scans);
+            for (size_t i = 0; i < scans; ++i)
+            {
+                reader.latest(latest);
+            }
+        }
+        writer.close();
+        HLDS::SharedScanWriter::unlink(name);
+    }
+    {
+        // The OutPort keeps one stream and rewinds it for every write
+        cdrMemoryStream cdr;
+        Timer timer("marshal", scans);
+        for (size_t i = 0; i < scans; ++i)
+        {
+            cdr.rewindPtrs();
+            range >>= cdr;
+        }
+    }
+    return 0;
+}
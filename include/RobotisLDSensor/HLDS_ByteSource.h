@@ -0,0 +1,175 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ByteSource.h
+ * @brief Byte stream transports of the LDS driver
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_BYTESOURCE_H
+#define HLDS_BYTESOURCE_H
+
+#include <functional>
+#include <stddef.h>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+#include <HLDS_Reactor.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Transport the sensor byte stream is read from
+*
+* LDSensor only reads the stream and sends the motor commands, so a
+* serial port, a capture file or anything else producing LDS packets can
+* stand in for the device.
+*/
+class ByteSource
+{
+public:
+	virtual ~ByteSource() {}
+
+	/**
+	* @brief Read the bytes available, blocking until there is at least one
+	* @return Number of bytes read, 0 at the end of the stream
+	*/
+	virtual size_t read(uint8_t* buffer, size_t length) = 0;
+
+	/**
+	* @brief Send a command to the sensor
+	*/
+	virtual void write(const uint8_t* data, size_t length) = 0;
+
+	/**
+	* @brief Whether the source supports asyncRead()
+	*/
+	virtual bool asynchronous() const { return false; }
+
+	typedef std::function<void(const boost::system::error_code&, size_t)>
+	ReadHandler;
+	/**
+	* @brief Start an asynchronous read on the shared Reactor
+	* The handler runs on the reactor thread with the number of bytes
+	* read, or with operation_aborted after cancel(). Only call it on
+	* the reactor thread.
+	*/
+	virtual void asyncRead(uint8_t*, size_t, const ReadHandler&)
+	{
+		throw std::logic_error("asynchronous read not supported");
+	}
+	/**
+	* @brief Abort the pending read, safe to call from any thread
+	* A pending asyncRead() completes with operation_aborted. Sources
+	* without asynchronous reads return 0 from the pending read().
+	*/
+	virtual void cancel() {}
+};
+
+/**
+* @brief Serial port settings beyond the baud rate
+*
+* USB serial adapters hold received bytes back for their latency timer
+* (16 ms by default on FTDI chips) unless asked to hand them over at
+* once, which shows up as bursty packet arrival.
+*/
+struct SerialOptions
+{
+	SerialOptions()
+	  : raw(true), vmin(1), vtime(0), lowLatency(true),
+	    rxBufferSize(0), txBufferSize(0)
+	{
+	}
+	// Raw termios mode with vmin and vtime (POSIX)
+	bool raw;
+	// Bytes a read waits for. With vtime 0 it is also the number of
+	// bytes the reactor is woken up for.
+	uint8_t vmin;
+	// Inter-byte timeout of a read in 0.1 s units
+	uint8_t vtime;
+	// ASYNC_LOW_LATENCY serial flag (Linux)
+	bool lowLatency;
+	// Driver buffer sizes, 0 keeps the driver default (Windows)
+	uint32_t rxBufferSize;
+	uint32_t txBufferSize;
+};
+
+/**
+* @brief Serial port connected to the sensor
+*
+* The port lives on the Reactor io_service, so any number of sensors
+* can be read by the single reactor thread. The reactor runs as long as
+* a SerialSource exists.
+*/
+class SerialSource : public ByteSource
+{
+public:
+	/**
+	* @param port Serial port device, e.g. "/dev/ttyUSB0"
+	* @param baud_rate The baud rate to open the serial port at
+	* @param options Latency related settings
+	*/
+	SerialSource(const std::string& port, uint32_t baud_rate,
+	             const SerialOptions& options = SerialOptions());
+	virtual ~SerialSource();
+
+	virtual size_t read(uint8_t* buffer, size_t length);
+	virtual void write(const uint8_t* data, size_t length);
+	virtual bool asynchronous() const { return true; }
+	virtual void asyncRead(uint8_t* buffer, size_t length,
+	                       const ReadHandler& handler);
+	virtual void cancel();
+
+private:
+	void configure(const std::string& port, const SerialOptions& options);
+
+	// asio's serial port object, served by the Reactor io_service
+	boost::asio::serial_port m_serial;
+};
+
+// Prefix of the port names replaying a capture file
+const char* const ReplayPrefix = "replay:";
+
+/**
+* @brief Open the byte source named by a port name
+* "replay:<file>" replays a capture file written by RecordingSource,
+* any other name is a serial port device.
+* @param replay_speed Replay speed relative to real time, 0 replays as
+* fast as possible
+* @param options Serial port settings
+*/
+ByteSource* openByteSource(const std::string& port, uint32_t baud_rate,
+                           double replay_speed = 1.0,
+                           const SerialOptions& options = SerialOptions());
+}
+
+#endif // HLDS_BYTESOURCE_H
@@ -0,0 +1,151 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Capture.h
+ * @brief Raw byte stream capture and replay
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_CAPTURE_H
+#define HLDS_CAPTURE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+
+#include <HLDS_ByteSource.h>
+
+
+namespace HLDS
+{
+
+/*
+ * Capture file layout, integers are little endian:
+ *   header:  "HLDSCAP1", baud rate (u32), reserved (u32)
+ *   records: arrival time in nanoseconds since the capture started
+ *            (u64), length (u32), the bytes returned by one read call
+ *
+ * Records keep the read boundaries of the original stream, so a replay
+ * goes through the framer with the same chunking as the live sensor.
+ */
+const char CaptureMagic[8] = { 'H', 'L', 'D', 'S', 'C', 'A', 'P', '1' };
+const size_t CaptureHeaderLength = 16;
+const size_t CaptureRecordHeaderLength = 12;
+
+/**
+* @brief Byte source writing everything it reads to a capture file
+*
+* A write error, e.g. on a full disk, is reported on std::cerr and ends
+* the recording; the reads go on and are passed through unchanged.
+*/
+class RecordingSource : public ByteSource
+{
+public:
+	/**
+	* @param source The source to record, owned by the RecordingSource
+	* @param path Capture file, truncated if it exists
+	* @param baud_rate Baud rate stored in the file header
+	*/
+	RecordingSource(ByteSource* source, const std::string& path,
+	                uint32_t baud_rate);
+	virtual ~RecordingSource();
+
+	virtual size_t read(uint8_t* buffer, size_t length);
+	virtual void write(const uint8_t* data, size_t length);
+	virtual bool asynchronous() const { return m_source->asynchronous(); }
+	virtual void asyncRead(uint8_t* buffer, size_t length,
+	                       const ReadHandler& handler);
+	virtual void cancel() { m_source->cancel(); }
+
+private:
+	// Append the bytes returned by one read as a record, never throws
+	void record(const uint8_t* buffer, size_t length);
+	void append(const void* data, size_t length);
+
+	std::unique_ptr<ByteSource> m_source;
+	std::string m_path;
+	FILE* m_file;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+* @brief Byte source replaying a memory mapped capture file
+*
+* Records are delivered with their original timing scaled by the replay
+* speed, or back to back when the speed is 0. Motor commands are
+* ignored. read() returns 0 after the last record, and from cancel()
+* on.
+*/
+class ReplaySource : public ByteSource
+{
+public:
+	/**
+	* @param path Capture file written by RecordingSource
+	* @param speed Replay speed relative to real time, 0 for as fast as
+	* possible
+	*/
+	ReplaySource(const std::string& path, double speed);
+	virtual ~ReplaySource();
+
+	virtual size_t read(uint8_t* buffer, size_t length);
+	virtual void write(const uint8_t* data, size_t length);
+	virtual void cancel();
+
+	/**
+	* @brief Baud rate the capture was recorded at
+	*/
+	uint32_t baudRate() const { return m_baudRate; }
+
+private:
+	// Wait until the record recorded at time is due
+	// @return false if interrupted by cancel()
+	bool pace(uint64_t time);
+
+	const uint8_t* m_data;
+	size_t m_size;
+	uint32_t m_baudRate;
+	double m_speed;
+	// Read position and bytes left in the current record
+	size_t m_offset;
+	size_t m_remaining;
+	// Replay clock, set on the first record
+	bool m_started;
+	uint64_t m_firstTime;
+	std::chrono::steady_clock::time_point m_start;
+	// Set by cancel(), only cleared on opening
+	bool m_cancelled;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+};
+}
+
+#endif // HLDS_CAPTURE_H
@@ -0,0 +1,171 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_CompactScan.h
+ * @brief Fixed point and delta coding of the CompactScan data type
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_COMPACTSCAN_H
+#define HLDS_COMPACTSCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Consumers build this header and HLDS_CompactScan.cpp on their own, it
+// depends on neither OpenRTM nor the rest of the driver.
+
+
+namespace HLDS
+{
+
+/**
+* @brief Beams of a coded scan, one revolution of the LDS-01
+*/
+const size_t CompactScanBeams = 360;
+
+/**
+* @brief Largest delta coded channel of count values
+*/
+inline size_t maxDeltaBytes(size_t count) { return 3 * count; }
+
+/**
+* @brief Ranges in metres to millimetres
+* Rounded to the nearest millimetre and saturated at 65535, no return
+* stays 0.
+*/
+void quantiseRanges(const double* ranges, size_t count, uint16_t* mm);
+
+/**
+* @brief Intensities to 16 bit, saturated
+*/
+void quantiseIntensities(const double* intensities, size_t count,
+                         uint16_t* values);
+
+/**
+* @brief Code values as differences to previous
+* The format is described with RobotisLDS::SCAN_DELTA in
+* CompactScan.idl.
+* @param previous count values, or NULL for a key frame
+* @param out At least maxDeltaBytes(count) bytes
+* @return Bytes written
+*/
+size_t deltaEncode(const uint16_t* values, const uint16_t* previous,
+                   size_t count, uint8_t* out);
+
+/**
+* @brief Decode values coded by deltaEncode()
+* @param previous The values the data was coded against, or NULL
+* @return Bytes read, 0 if the data is malformed
+*/
+size_t deltaDecode(const uint8_t* data, size_t length,
+                   const uint16_t* previous, size_t count, uint16_t* values);
+
+/**
+* @brief Delta coder of consecutive revolutions
+*
+* Every scan is coded against the previous one, except a key frame
+* every keyFrameInterval() scans, after reset() and when intensities
+* appear or disappear. A consumer that missed a scan can resume from
+* the next key frame.
+*/
+class CompactEncoder
+{
+public:
+	CompactEncoder();
+
+	/**
+	* @brief Scans from one key frame to the next, 1 for key frames only
+	*/
+	void setKeyFrameInterval(size_t interval);
+	size_t keyFrameInterval() const { return m_interval; }
+
+	/**
+	* @brief Make the next scan a key frame
+	*/
+	void reset();
+
+	/**
+	* @brief Code a revolution
+	* @param intensities CompactScanBeams intensities, or NULL
+	* @param out At least 2 * maxDeltaBytes(CompactScanBeams) bytes
+	* @param seq Number of this scan
+	* @param reference Number of the scan it is coded against, seq for a
+	* key frame
+	* @return Bytes written
+	*/
+	size_t encode(const uint16_t* ranges, const uint16_t* intensities,
+	              uint8_t* out, uint32_t& seq, uint32_t& reference);
+
+	/**
+	* @brief Number a scan sent uncoded, as RobotisLDS::SCAN_RAW
+	* The next coded scan is a key frame.
+	* @return Number of the scan
+	*/
+	uint32_t rawFrame();
+
+private:
+	uint16_t m_ranges[CompactScanBeams];
+	uint16_t m_intensities[CompactScanBeams];
+	bool m_hasIntensities;
+	uint32_t m_seq;
+	size_t m_interval;
+	// Scans until the next key frame, 0 for the next one
+	size_t m_countdown;
+};
+
+/**
+* @brief Decoder of the scans of a CompactEncoder
+*/
+class CompactDecoder
+{
+public:
+	CompactDecoder();
+
+	/**
+	* @brief Decode a revolution
+	* @param intensities CompactScanBeams values, decoded only when the scan has
+	* intensities, may be NULL otherwise
+	* @return false if the scan is coded against a scan that was not the
+	* last one decoded, or is malformed; the outputs are then undefined
+	* until the next key frame
+	*/
+	bool decode(uint32_t seq, uint32_t reference, const uint8_t* data,
+	            size_t length, bool has_intensities, uint16_t* ranges,
+	            uint16_t* intensities);
+
+private:
+	uint16_t m_ranges[CompactScanBeams];
+	uint16_t m_intensities[CompactScanBeams];
+	bool m_valid;
+	uint32_t m_seq;
+};
+}
+
+#endif // HLDS_COMPACTSCAN_H
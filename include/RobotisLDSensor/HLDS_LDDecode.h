@@ -0,0 +1,248 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDDecode.h
+ * @brief Decoding of LDS frames into caller supplied buffers
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_LDDECODE_H
+#define HLDS_LDDECODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <HLDS_LDFramer.h>
+
+
+namespace HLDS
+{
+
+// Number of beams in one revolution, 1 degree apart
+const uint16_t BeamCount = 360;
+// Number of beams in one packet
+const uint16_t BeamsPerPacket = 6;
+
+/**
+* @brief One revolution as received from the sensor
+*/
+struct RawFrame
+{
+	uint8_t bytes[FrameLength];
+	// Bit n is set when packet n passed validation
+	uint64_t valid;
+	// Arrival of the first and of the last packet, monotonicNow()
+	uint64_t firstPacketTime;
+	uint64_t completeTime;
+	// Arrival of the first packet, wall clock in ns since the epoch
+	uint64_t firstPacketWallTime;
+	// Revolution period estimated up to this frame [ns], 0 while unknown
+	uint64_t period;
+};
+
+/**
+* @brief Timing of a revolution, estimated from the packet arrival times
+*
+* The packets of a revolution arrive evenly spaced and each one is sent
+* once its six beams are measured, so beam j of the revolution (sample
+* k of packet n, j = 6n + k) is measured at start + j * beamPeriod.
+* The beam period is the estimated revolution period of the frame over
+* BeamCount, or while there is none the spread of the packet arrivals.
+*/
+struct ScanTiming
+{
+	// Measurement of the first beam, monotonicNow() and wall clock [ns]
+	uint64_t start;
+	uint64_t wallStart;
+	// Time between two beams [s]
+	double beamPeriod;
+};
+
+/**
+* @brief One packet, delivered as soon as it is received and validated
+*
+* Packet n covers beams 354 - 6n to 359 - 6n of the revolution.
+*/
+struct Sector
+{
+	// Packet index n, 0-59
+	uint16_t index;
+	uint8_t bytes[PacketLength];
+};
+
+/**
+* @brief Destination of a decoded revolution
+*
+* Beam b of the revolution (counter-clockwise from the sensor's zero
+* direction) is written to ranges[(b + shift) % BeamCount] in metres
+* multiplied by scale. Beams of invalid packets are written as 0.
+*/
+template <typename T>
+struct ScanSpan
+{
+	// BeamCount range values
+	T* ranges;
+	// BeamCount intensity values, or NULL
+	T* intensities;
+	// Scale factor on top of the millimetre to metre conversion
+	double scale;
+	// Rotation in beams, [0, BeamCount)
+	size_t shift;
+};
+
+/**
+* @brief Checksum of a packet
+* The 20 little endian words of bytes 0-39 are accumulated as
+* chk = (chk << 1) + word in 32 bits and folded to 15 bits; the sensor
+* sends the result in bytes 40-41. Runs the same kernel as
+* decodeFrame().
+*/
+uint16_t packetChecksum(const uint8_t* packet);
+
+/**
+* @brief Store the checksum of bytes 0-39 in bytes 40-41
+*/
+void writeChecksum(uint8_t* packet);
+
+/**
+* @brief Validate the header of packet n: [0xFA, 0xA0 + n]
+*/
+bool validateHeader(const uint8_t* packet, uint16_t n);
+
+/**
+* @brief Validate the header and the checksum of packet n
+*/
+bool validatePacket(const uint8_t* packet, uint16_t n);
+
+/**
+* @brief Validate the packets of a frame
+* @return Bit mask of the packets with a correct header and checksum
+*/
+uint64_t validatePackets(const uint8_t* frame);
+
+/**
+* @brief Rotation in beams for an angular offset
+* @param offset Angular offset in radian
+* @param increment Angle between beams in radian
+*/
+size_t rotationShift(double offset, double increment);
+
+/**
+* @brief Timing of a complete revolution
+*/
+ScanTiming scanTiming(const RawFrame& frame);
+
+/**
+* @brief Measurement time of every beam relative to the first one
+* @param out BeamCount offsets in seconds, in the order of the ranges
+* decoded with the same shift
+*/
+void beamTimes(const ScanTiming& timing, double* out, size_t shift);
+
+/**
+* @brief Rotation and scaling of a scan, computed once per configuration
+*
+* Beam b goes to (b + shift) % BeamCount, which is two contiguous spans:
+* beams [0, BeamCount - shift) to [shift, BeamCount) and the remaining
+* shift beams to [0, shift).
+*/
+struct RotationPlan
+{
+	// Scale factor on top of the millimetre to metre conversion
+	double scale;
+	// Rotation in beams, [0, BeamCount)
+	size_t shift;
+	struct Span
+	{
+		size_t from;
+		size_t to;
+		size_t length;
+	} spans[2];
+};
+
+/**
+* @brief Plan the rotation for an angular offset
+* @param offset Angular offset in radian
+* @param increment Angle between beams in radian
+* @param scale Scale factor applied to every range
+*/
+RotationPlan makeRotationPlan(double offset, double increment, double scale);
+
+/**
+* @brief Rotate and scale a decoded scan as two bulk copies
+* @param scan BeamCount values in beam order
+* @param out BeamCount values, scan rotated by the plan and scaled
+*/
+template <typename In, typename Out>
+inline void rotateScan(const In* scan, Out* out, const RotationPlan& plan)
+{
+	for (size_t s = 0; s < 2; ++s)
+	{
+		const In* src = scan + plan.spans[s].from;
+		Out* dst = out + plan.spans[s].to;
+		for (size_t i = 0; i < plan.spans[s].length; ++i)
+		{
+			dst[i] = Out(src[i] * plan.scale);
+		}
+	}
+}
+
+/**
+* @brief Decode a revolution straight into the destination buffers
+* Every sample is read from the frame and written to its final place
+* once, no intermediate scan is built. Runs the fastest kernel
+* available on this CPU (AVX2, NEON, SSE2 or scalar), chosen on first
+* use; all kernels give bit exact results of decodeFrameScalar().
+*/
+template <typename T>
+void decodeFrame(const RawFrame& frame, const ScanSpan<T>& out);
+
+/**
+* @brief Portable reference implementation of decodeFrame()
+*/
+template <typename T>
+void decodeFrameScalar(const RawFrame& frame, const ScanSpan<T>& out);
+
+/**
+* @brief Decode the six beams of a sector
+* Values are written in ascending beam order, starting with beam
+* 354 - 6n, as in-range metres multiplied by scale.
+* @param intensities Six intensity values, or NULL
+*/
+template <typename T>
+void decodeSector(const Sector& sector, T* ranges, T* intensities,
+                  double scale);
+
+/**
+* @brief Name of the kernel used by decodeFrame() and packetChecksum()
+*/
+const char* decodeKernel();
+}
+
+#endif // HLDS_LDDECODE_H
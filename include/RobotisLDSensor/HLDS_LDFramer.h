@@ -0,0 +1,172 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDFramer.h
+ * @brief Ring buffer framer for the LDS serial byte stream
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_LDFRAMER_H
+#define HLDS_LDFRAMER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace HLDS
+{
+
+// One revolution: 60 packets of 42 bytes
+const uint16_t FrameLength = 2520;
+const uint16_t PacketLength = 42;
+const uint16_t PacketCount = 60;
+
+/**
+* @brief Snapshot of the framer counters
+*/
+struct FramerStats
+{
+	// Number of read calls, i.e. system calls on the serial port
+	uint64_t reads;
+	// Total number of bytes received
+	uint64_t bytes;
+	// Number of packets extracted
+	uint64_t packets;
+	// Number of complete frames extracted
+	uint64_t frames;
+	// Bytes skipped while hunting for a packet header
+	uint64_t discarded;
+	// Number of times packet alignment was lost and found again, the
+	// first lock after start or reset() is not counted
+	uint64_t resyncs;
+
+	double bytesPerRead() const
+	{
+		return reads == 0 ? 0.0 : double(bytes) / reads;
+	}
+};
+
+/**
+* @brief Extracts LDS packets from the raw serial byte stream
+*
+* The reader thread asks for writePtr()/writeSpace(), reads as many bytes
+* as the tty has available directly into the ring and calls commit().
+* nextPacket() then hands out the packets one by one as soon as each one
+* is complete, with the index n of its 0xFA 0xA0 + n header.
+*
+* The framer locks onto the header of any packet, not just the first
+* one of a revolution. A header found while hunting is only taken when
+* another header follows it a packet later, a byte pair inside a packet
+* rarely passes for two. Once locked, a packet is taken as soon as it is
+* complete. A packet a byte short or long is skipped if the next header
+* is already buffered, otherwise the framer hunts again from where the
+* next header should have been. A byte lost or gained costs the packet
+* it hit, and at worst the one after it. The counters can be read from
+* any thread through stats().
+*/
+class LDFramer
+{
+public:
+	LDFramer();
+
+	/**
+	* @brief Start of the contiguous free space in the ring
+	*/
+	uint8_t* writePtr() { return &m_ring[m_tail & Mask]; }
+	/**
+	* @brief Size of the contiguous free space in the ring
+	*/
+	size_t writeSpace() const;
+	/**
+	* @brief Account for bytes written to writePtr() by one read call
+	* @param length Number of bytes read
+	*/
+	void commit(size_t length);
+
+	/**
+	* @brief Index of the next complete packet, without taking it
+	* Lets the caller finish a revolution before the packet of the next
+	* one overwrites its slot.
+	* @return The packet index n, or -1 if more data is needed
+	*/
+	int packetIndex();
+
+	/**
+	* @brief Extract the next complete packet from the ring
+	* @param frame Frame buffer of FrameLength bytes, packet n is copied
+	* to frame + n * PacketLength
+	* @return The packet index n, or -1 if more data is needed
+	*/
+	int nextPacket(uint8_t* frame);
+
+	/**
+	* @brief Drop all buffered bytes and hunt for the next packet
+	*/
+	void reset()
+	{
+		m_head = m_tail; m_locked = false; m_lost = false; m_last = -1;
+	}
+
+	FramerStats stats() const;
+
+private:
+	// Ring capacity, a power of two holding a few frames
+	enum { Capacity = 8192, Mask = Capacity - 1 };
+
+	// Byte at the given offset from the read position
+	uint8_t at(size_t offset) const { return m_ring[(m_head + offset) & Mask]; }
+	// Packet index of a 0xFA 0xA0 + n header at the given offset, or -1
+	int headerAt(size_t offset) const;
+	// Drop bytes from the read position
+	void discard(size_t length);
+	// Skip to the next header followed by another one
+	bool synchronize();
+
+	uint8_t m_ring[Capacity];
+	// Free running read and write positions
+	size_t m_head;
+	size_t m_tail;
+	// The read position is at a packet header
+	bool m_locked;
+	// Alignment was lost after having been found
+	bool m_lost;
+	// Index of the last packet taken, -1 at the start of a revolution
+	int m_last;
+	// Counters, written by the reader thread only
+	std::atomic<uint64_t> m_reads;
+	std::atomic<uint64_t> m_bytes;
+	std::atomic<uint64_t> m_packets;
+	std::atomic<uint64_t> m_frames;
+	std::atomic<uint64_t> m_discarded;
+	std::atomic<uint64_t> m_resyncs;
+};
+}
+
+#endif // HLDS_LDFRAMER_H
@@ -32,10 +32,26 @@
  * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
-#include <boost/asio.hpp>
+#ifndef HLDS_LDSENSOR_H
+#define HLDS_LDSENSOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <HLDS_ByteSource.h>
+#include <HLDS_LDDecode.h>
+#include <HLDS_LDFramer.h>
+#include <HLDS_Latency.h>
+#include <HLDS_SpeedEstimator.h>
+#include <HLDS_SpscQueue.h>
+#include <HLDS_TripleBuffer.h>
+
 
 namespace HLDS
 {
@@ -53,6 +69,19 @@ struct LaserScan
 	std::vector<float> intensities;
 };
 
+/**
+* @brief Packet validation counters
+* Bytes lost or corrupted between packets show up in the framer
+* counters, FramerStats::discarded and FramerStats::resyncs.
+*/
+struct PacketStats
+{
+	// Packets passing validation
+	uint64_t good;
+	// Packets with a wrong checksum
+	uint64_t badChecksum;
+};
+
 class LDSensor
 {
 public:
@@ -63,6 +92,11 @@ public:
 	* @param io Boost ASIO IO Service to use when creating the serial port object
 	*/
 	LDSensor(const std::string& port, uint32_t baud_rate);
+	/**
+	* @brief Constructs a new LDSensor reading from the given byte source
+	* @param source Serial port, capture replay, etc. owned by the LDSensor
+	*/
+	explicit LDSensor(ByteSource* source);
 
 	/**
 	* @brief Default destructor
@@ -88,27 +122,277 @@ public:
 	* frame_id
 	*/
 	void poll(LaserScan& scan);
+	/**
+	* @brief Estimated rotation speed, rounded to whole rpm
+	* RawFrame::period carries the estimate at full resolution.
+	*/
 	uint16_t rpm() { return m_rpms; }
 
 	/**
-	* @brief Close the driver down and prevent the polling loop from advancing
+	* @brief Read the next raw revolution. Blocks until a complete frame
+	* is received or close is called.
+	* @param frame Frame to fill in, with the packet validity mask set
+	* @return false if interrupted by close or at the end of the stream
+	*/
+	bool readFrame(RawFrame& frame);
+
+	/**
+	* @brief Start the background acquisition
+	* Every complete revolution is handed to latestFrame() through a
+	* wait-free triple buffer. Serial ports are read asynchronously by
+	* the shared Reactor thread, other sources by a thread of their own
+	* calling readFrame().
+	*/
+	void startAcquisition();
+	/**
+	* @brief Stop the background acquisition
+	* The pending read is cancelled and the pending asyncNextScan() and
+	* asyncNextSector() operations complete with operation_aborted.
+	*/
+	void stopAcquisition();
+	/**
+	* @brief Get the newest revolution read by the acquisition thread
+	* Never blocks. The returned frame stays valid until the next call,
+	* decode it with decodeFrame().
+	* @return The newest frame, or NULL if no new frame arrived since the
+	* last call
+	*/
+	const RawFrame* latestFrame();
+
+	typedef std::function<void(const Sector&)> SectorCallback;
+	/**
+	* @brief Set a function called for every valid packet
+	* The callback runs on the acquisition or reactor thread as soon as
+	* the packet is received, it must not block, since the reactor thread
+	* serves the other sensors too. Set it before startAcquisition().
+	*/
+	void setSectorCallback(const SectorCallback& callback);
+	/**
+	* @brief Queue every valid packet for nextSector()
+	*/
+	void setSectorStreaming(bool enable);
+	/**
+	* @brief Take the oldest queued sector, never blocks
+	* @return false if no sector is queued
+	*/
+	bool nextSector(Sector& sector);
+
+	/**
+	* @brief Wait asynchronously for the next revolution
+	* Completes once the acquisition started by startAcquisition()
+	* delivers the next frame, or with operation_aborted after close()
+	* or stopAcquisition(). The handler runs on the executor associated
+	* with the completion token, e.g. the coroutine's executor with
+	* boost::asio::use_awaitable.
+	* @param scan Filled in as poll() does before completion, it must
+	* stay alive until then
+	*/
+	template <typename CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+	                              void(boost::system::error_code))
+	asyncNextScan(LaserScan& scan, CompletionToken&& token)
+	{
+		return boost::asio::async_initiate<CompletionToken,
+		                                   void(boost::system::error_code)>(
+			[this, &scan](auto handler)
+			{
+				waitScan(&scan, bindWaitHandler(std::move(handler)));
+			}, token);
+	}
+	/**
+	* @brief Wait asynchronously for the next valid packet
+	* Independent of setSectorStreaming(), see asyncNextScan().
+	*/
+	template <typename CompletionToken>
+	BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+	                              void(boost::system::error_code))
+	asyncNextSector(Sector& sector, CompletionToken&& token)
+	{
+		return boost::asio::async_initiate<CompletionToken,
+		                                   void(boost::system::error_code)>(
+			[this, &sector](auto handler)
+			{
+				waitSector(&sector, bindWaitHandler(std::move(handler)));
+			}, token);
+	}
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+	/**
+	* @brief co_await the next revolution, throws on close()
+	*/
+	boost::asio::awaitable<void> awaitScan(LaserScan& scan)
+	{
+		return asyncNextScan(scan, boost::asio::use_awaitable);
+	}
+	/**
+	* @brief co_await the next valid packet, throws on close()
+	*/
+	boost::asio::awaitable<void> awaitSector(Sector& sector)
+	{
+		return asyncNextSector(sector, boost::asio::use_awaitable);
+	}
+#endif
+	/**
+	* @brief Number of sectors dropped because the queue was full
+	*/
+	uint64_t droppedSectors() const { return m_droppedSectors; }
+
+	/**
+	* @brief Enable or disable packet checksum verification
+	* Enabled by default. Packets with a wrong checksum are marked
+	* invalid and decoded as 0.
+	*/
+	void setChecksumCheck(bool enable) { m_checkChecksum = enable; }
+	/**
+	* @brief Packet validation counters
+	* Safe to call from any thread.
+	*/
+	PacketStats packetStats() const;
+	/**
+	* @brief Time from the first to the last packet of a revolution
+	* Safe to call from any thread.
 	*/
-	void close() { m_shuttingDown = true; }
+	LatencySummary frameLatency() const { return m_frameLatency.summary(); }
+	/**
+	* @brief Inter-packet arrival jitter
+	* Deviation of the interval between two consecutive packets of a
+	* revolution from the mean packet interval of that revolution.
+	* Safe to call from any thread.
+	*/
+	LatencySummary packetJitter() const { return m_packetJitter.summary(); }
+
+	/**
+	* @brief Whether the acquisition stopped on an I/O error
+	*/
+	bool failed() const { return m_failed; }
+	/**
+	* @brief Serial read counters of the framer
+	* Safe to call from any thread.
+	*/
+	FramerStats stats() const { return m_framer.stats(); }
+
+	/**
+	* @brief Close the driver down
+	* Interrupts a blocking poll() or readFrame() and aborts the pending
+	* asynchronous waits. Safe to call from any thread.
+	*/
+	void close();
 
 private:
+	typedef std::function<void(const boost::system::error_code&)>
+	WaitHandler;
+	struct ScanWaiter
+	{
+		LaserScan* scan;
+		WaitHandler handler;
+	};
+	struct SectorWaiter
+	{
+		Sector* sector;
+		WaitHandler handler;
+	};
+	// Wrap an asio completion handler: completion is posted to the
+	// handler's executor, which is kept busy until then
+	template <typename Handler>
+	static WaitHandler bindWaitHandler(Handler handler)
+	{
+		typedef typename std::decay<decltype(boost::asio::prefer(
+			boost::asio::get_associated_executor(handler),
+			boost::asio::execution::outstanding_work.tracked))>::type Work;
+		// std::function needs a copyable target, asio handlers are
+		// move only
+		struct Pending
+		{
+			Handler handler;
+			Work work;
+		};
+		Work work = boost::asio::prefer(
+			boost::asio::get_associated_executor(handler),
+			boost::asio::execution::outstanding_work.tracked);
+		std::shared_ptr<Pending> pending(
+			new Pending{ std::move(handler), work });
+		return [pending](const boost::system::error_code& ec)
+		{
+			boost::asio::post(pending->work, [pending, ec]()
+			{
+				std::move(pending->handler)(ec);
+			});
+		};
+	}
+	void waitScan(LaserScan* scan, const WaitHandler& handler);
+	void waitSector(Sector* sector, const WaitHandler& handler);
+	// Complete every pending wait with operation_aborted
+	void abortWaits();
+	// Hand the completed write buffer frame over
+	void deliverFrame();
+	// Record the packet arrival jitter of a complete revolution
+	void recordJitter();
+	// Fill in a LaserScan from a revolution
+	static void fillScan(const RawFrame& frame, LaserScan& scan);
+	// Blocking read into the framer, 0 when closed
+	size_t readSome();
+
+	void acquisitionLoop();
+	// Process the buffered packets, true when frame is complete
+	bool extractFrame(RawFrame& frame);
+	// Time the revolution, it ends with packet m_lastPacket
+	void completeFrame(RawFrame& frame);
+	// Asynchronous acquisition on the Reactor
+	void startRead();
+	void onRead(const boost::system::error_code& ec, size_t length);
+
 	// Serial port name: /dev/ttyUSB0, COM1, etc.
 	std::string m_port; 
 	// Baudrate of the serial port
 	uint32_t m_baudRate;
 	// Shutting down flag
-	bool m_shuttingDown;
-	// Motor speed
-	uint16_t m_motorSpeed;
+	std::atomic<bool> m_shuttingDown;
+	// Acquisition thread terminated by an exception
+	std::atomic<bool> m_failed;
+	// Revolution period from speed fields and arrival times
+	SpeedEstimator m_speed;
 	// Motor rotation speed in RPM
-	uint16_t m_rpms;
-	// asio::ioservice for the serial port access
-	boost::asio::io_service m_io;
-	// asio's serial port object
-	boost::asio::serial_port m_serial;
+	std::atomic<uint16_t> m_rpms;
+	// Serial port or other transport of the byte stream
+	std::unique_ptr<ByteSource> m_source;
+	// Frame extraction from the raw byte stream
+	LDFramer m_framer;
+	// Background acquisition thread
+	std::thread m_thread;
+	// Serial ports are read on the Reactor
+	bool m_async;
+	// Asynchronous acquisition: set while a read is pending on the Reactor
+	bool m_reading;
+	std::mutex m_readMutex;
+	std::condition_variable m_readDone;
+	// Frames handed from the acquisition thread to the reader
+	TripleBuffer<RawFrame> m_frames;
+	// Per packet delivery
+	SectorCallback m_sectorCallback;
+	std::atomic<bool> m_sectorStreaming;
+	SpscQueue<Sector, 128> m_sectors;
+	std::atomic<uint64_t> m_droppedSectors;
+	// Pending asynchronous waits
+	std::mutex m_waitMutex;
+	std::vector<ScanWaiter> m_scanWaiters;
+	std::vector<SectorWaiter> m_sectorWaiters;
+	std::atomic<bool> m_scanWaiting;
+	std::atomic<bool> m_sectorWaiting;
+	// Packet validation
+	std::atomic<bool> m_checkChecksum;
+	std::atomic<uint64_t> m_goodPackets;
+	std::atomic<uint64_t> m_badChecksums;
+	// Arrival time of the bytes of the last read
+	uint64_t m_readTime;
+	LatencyHistogram m_frameLatency;
+	// Arrival time of the packets of the current revolution
+	uint64_t m_packetTimes[PacketCount];
+	// Packets of the current revolution received, valid or not
+	uint64_t m_received;
+	// Index of the last packet received, -1 before the first one of a
+	// revolution
+	int m_lastPacket;
+	LatencyHistogram m_packetJitter;
 };
 }
+
+#endif // HLDS_LDSENSOR_H
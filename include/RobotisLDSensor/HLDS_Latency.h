@@ -0,0 +1,118 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Latency.h
+ * @brief Monotonic timestamps and latency histograms
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_LATENCY_H
+#define HLDS_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Monotonic clock in nanoseconds, the time base of all stages
+*/
+inline uint64_t monotonicNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+* @brief Wall clock in nanoseconds since the epoch
+*/
+inline uint64_t wallClockNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+* @brief Summary of a latency histogram, in nanoseconds
+* Percentiles are the upper bound of their bucket, at most 12.5% above
+* the exact value.
+*/
+struct LatencySummary
+{
+	uint64_t count;
+	uint64_t p50;
+	uint64_t p99;
+	uint64_t max;
+};
+
+/**
+* @brief Log-linear histogram of latencies
+*
+* Each power of two range is split into 8 buckets. record() is a handful
+* of instructions and two relaxed atomic stores, cheap enough to stay
+* enabled. One thread records, any thread may call summary().
+*/
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	/**
+	* @brief Add a sample
+	* @param ns Latency in nanoseconds
+	*/
+	void record(uint64_t ns);
+
+	/**
+	* @brief Count, p50, p99 and max of the samples recorded so far
+	*/
+	LatencySummary summary() const;
+
+	/**
+	* @brief Drop all samples, only while nothing is recorded
+	*/
+	void reset();
+
+private:
+	enum { SubBits = 3, SubBuckets = 1 << SubBits,
+	       BucketCount = (64 - SubBits) * SubBuckets + SubBuckets };
+
+	static size_t bucket(uint64_t ns);
+	static uint64_t upperBound(size_t bucket);
+
+	std::atomic<uint64_t> m_buckets[BucketCount];
+	std::atomic<uint64_t> m_max;
+};
+}
+
+#endif // HLDS_LATENCY_H
@@ -0,0 +1,123 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_OccupancyGrid.h
+ * @brief Local occupancy grid updated by ray casting
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_OCCUPANCYGRID_H
+#define HLDS_OCCUPANCYGRID_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Occupancy grid centred on the sensor
+*
+* Every cell holds the log odds of being occupied as a small integer.
+* Each revolution lowers the cells a beam passes through and raises the
+* cell it ends in, with saturation, so the grid follows a changing
+* scene within a few revolutions.
+*
+* The cells each beam direction crosses are traced once by integer
+* Bresenham lines to the edge of the grid and kept in a ray table. An
+* update walks at most BeamCount rays of size / 2 cells, whatever the
+* scene, and allocates nothing; the image of the grid is updated along.
+*
+* The grid is in the sensor frame: x along beam 0, y along beam 90. Row
+* 0 is the +y edge, column 0 the -x edge.
+*/
+class OccupancyGrid
+{
+public:
+	// Log odds steps of a beam ending in and passing through a cell
+	enum { HitStep = 24, MissStep = 6, LogOddsMax = 120 };
+
+	OccupancyGrid();
+
+	/**
+	* @brief Resize, clear and trace the ray table
+	* @param size Cells along each side, rounded up to an odd count so
+	* the sensor is in the centre cell
+	* @param resolution Side of a cell, in the unit of the ranges
+	*/
+	void configure(size_t size, double resolution);
+
+	/**
+	* @brief Forget every observation
+	*/
+	void clear();
+
+	/**
+	* @brief Add a revolution
+	* Beams without a return (range 0) are ignored, returns beyond the
+	* grid only clear the cells inside it.
+	* @param ranges BeamCount ranges, beam i at i degrees
+	*/
+	void update(const double* ranges);
+
+	/**
+	* @brief Occupancy probability of every cell, row by row
+	* size() * size() bytes: 0 free, 255 occupied, 128 unknown. Kept up
+	* to date by update() along with the cells it changes.
+	*/
+	const uint8_t* image() const { return m_image.data(); }
+
+	size_t size() const { return m_size; }
+	double resolution() const { return m_resolution; }
+
+private:
+	size_t m_size;
+	double m_resolution;
+	// Log odds of the cells and their image, row by row
+	std::vector<int8_t> m_cells;
+	std::vector<uint8_t> m_image;
+	// Cell indices of ray i at m_rays[i * m_rayStride], from the cell next
+	// to the centre outwards, m_rayLength[i] of them
+	std::vector<uint32_t> m_rays;
+	size_t m_rayStride;
+	uint16_t m_rayLength[BeamCount];
+	// Cells advanced per unit of range along ray i, 16.16 fixed point
+	uint32_t m_rayScale[BeamCount];
+	// Pixel of each log odds value, offset by LogOddsMax
+	uint8_t m_pixel[2 * LogOddsMax + 1];
+
+	void add(uint32_t cell, int step);
+};
+}
+
+#endif // HLDS_OCCUPANCYGRID_H
@@ -0,0 +1,170 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_PointCloud.h
+ * @brief Conversion of a scan to points in the robot frame
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_POINTCLOUD_H
+#define HLDS_POINTCLOUD_H
+
+#include <math.h>
+#include <stddef.h>
+
+#include <HLDS_LDDecode.h>
+
+// makeBeamTrig() loops in a constant expression
+#if defined(_MSVC_LANG) ? _MSVC_LANG < 201402L : __cplusplus < 201402L
+#error "HLDS_PointCloud.h needs C++14"
+#endif
+
+
+namespace HLDS
+{
+
+/**
+* @brief Cosine and sine of the direction of every beam
+*
+* Beam i of a revolution points i degrees counter-clockwise from the x
+* axis of the sensor, so the directions are a fixed grid known at
+* compile time.
+*/
+struct BeamTrig
+{
+	double cos[BeamCount];
+	double sin[BeamCount];
+};
+
+namespace detail
+{
+// sin(x) and cos(x) for |x| <= pi / 4 by their Taylor series to x^17,
+// below one unit in the last place
+constexpr double sinSeries(double x)
+{
+	double x2 = x * x;
+	double sum = 1.0;
+	for (int n = 16; n >= 2; n -= 2)
+	{
+		sum = 1.0 - x2 / (n * (n + 1)) * sum;
+	}
+	return x * sum;
+}
+
+constexpr double cosSeries(double x)
+{
+	double x2 = x * x;
+	double sum = 1.0;
+	for (int n = 16; n >= 2; n -= 2)
+	{
+		sum = 1.0 - x2 / (n * (n - 1)) * sum;
+	}
+	return sum;
+}
+
+// Reduced by symmetry to [0, 45] degrees, exact at multiples of 90
+constexpr double sinDegree(int degree)
+{
+	return degree > 180 ? -sinDegree(degree - 180) :
+	       degree > 90 ? sinDegree(180 - degree) :
+	       degree > 45 ? cosSeries((90 - degree) * (M_PI / 180)) :
+	       sinSeries(degree * (M_PI / 180));
+}
+}
+
+/**
+* @brief The beam direction table, usable in constant expressions
+*/
+constexpr BeamTrig makeBeamTrig()
+{
+	static_assert(BeamCount == 360, "the beam grid is one degree");
+	BeamTrig trig = {};
+	for (int i = 0; i < BeamCount; ++i)
+	{
+		trig.sin[i] = detail::sinDegree(i);
+		trig.cos[i] = detail::sinDegree((i + 90) % 360);
+	}
+	return trig;
+}
+
+/**
+* @brief Mounting of the sensor on the robot, computed once per
+* configuration
+*
+* The beams lie in the x-y plane of the sensor, so only the first two
+* columns of the rotation are kept. A point at range r along beam i is
+* x * r cos(i) + y * r sin(i) + t in the robot frame.
+*/
+struct MountTransform
+{
+	// Sensor x axis in the robot frame
+	double x[3];
+	// Sensor y axis in the robot frame
+	double y[3];
+	// Sensor origin in the robot frame
+	double t[3];
+};
+
+/**
+* @brief Plan the mount transform
+* @param x, y, z Position of the sensor on the robot
+* @param roll, pitch, yaw Orientation in radian, applied about the x,
+* y and then z axes of the robot
+*/
+MountTransform makeMountTransform(double x, double y, double z,
+                                  double roll, double pitch, double yaw);
+
+/**
+* @brief Points of a revolution in the robot frame, one per beam
+*/
+struct PointScan
+{
+	double x[BeamCount];
+	double y[BeamCount];
+	double z[BeamCount];
+};
+
+/**
+* @brief Convert a revolution to points in the robot frame
+* Runs the fastest kernel available on this CPU (AVX2 or scalar), chosen
+* on first use; all kernels give bit exact results of the scalar one.
+* A beam without a return (range 0) gives the sensor origin, callers
+* drop it by its range.
+* @param ranges BeamCount ranges, beam i at i degrees
+*/
+void scanToPoints(const MountTransform& mount, const double* ranges,
+                  PointScan& points);
+
+/**
+* @brief Name of the kernel used by scanToPoints()
+*/
+const char* pointKernel();
+}
+
+#endif // HLDS_POINTCLOUD_H
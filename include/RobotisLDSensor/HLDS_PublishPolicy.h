@@ -0,0 +1,140 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_PublishPolicy.h
+ * @brief Per port publication policies
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_PUBLISHPOLICY_H
+#define HLDS_PUBLISHPOLICY_H
+
+#include <stdint.h>
+#include <string>
+
+
+namespace HLDS
+{
+
+/**
+* @brief When a port publishes a scan
+*
+* A scan is published when all conditions hold, the defaults publish
+* every scan.
+*/
+struct PublishPolicy
+{
+	PublishPolicy()
+	  : every(1), period(0), coalesce(false)
+	{
+	}
+	// Publish one scan in every scans
+	uint32_t every;
+	// Shortest average interval between publications [ns], 0 for no limit
+	uint64_t period;
+	// Hold scans back while a consumer has not taken the previous one, the
+	// newest scan goes out once it has
+	bool coalesce;
+};
+
+/**
+* @brief Policy from a comma separated list of terms
+* "all" publishes every scan, "every:N" one in N scans, "rate:HZ" at most
+* HZ scans per second on average and "latest" coalesces scans for a slow
+* consumer, e.g. "rate:1" or "every:2,latest".
+* @return false if the text is not a policy, policy is then unchanged
+*/
+bool parsePublishPolicy(const std::string& text, PublishPolicy& policy);
+
+/**
+* @brief Scans offered to a port and what became of them
+*/
+struct PublishStats
+{
+	PublishStats()
+	  : published(0), dropped(0), coalesced(0)
+	{
+	}
+	uint64_t offered() const { return published + dropped + coalesced; }
+	uint64_t published;
+	// Not due under the every or rate condition
+	uint64_t dropped;
+	// Due, but held back for a busy consumer
+	uint64_t coalesced;
+};
+
+/**
+* @brief Decides scan by scan whether a port publishes
+*
+* Ports ask before doing any work for a scan, so a scan that is not
+* published costs nothing beyond the decision.
+*/
+class PublishGate
+{
+public:
+	PublishGate();
+
+	/**
+	* @brief Change the policy, starting with the next scan due
+	* The counts are kept.
+	*/
+	void setPolicy(const PublishPolicy& policy);
+	const PublishPolicy& policy() const { return m_policy; }
+	/**
+	* @brief Whether admit() needs to know if the consumer is busy
+	*/
+	bool coalescing() const { return m_policy.coalesce; }
+
+	/**
+	* @brief Decide on a scan
+	* A scan held back for a busy consumer leaves the next scan due.
+	* @param now Monotonic time [ns]
+	* @param busy Whether a consumer has not taken the previous scan yet
+	* @return true if the scan is to be published
+	*/
+	bool admit(uint64_t now, bool busy = false);
+
+	const PublishStats& stats() const { return m_stats; }
+	void resetStats() { m_stats = PublishStats(); }
+
+private:
+	bool due(uint64_t now);
+
+	PublishPolicy m_policy;
+	PublishStats m_stats;
+	// Scans since the last one due under the every condition
+	uint32_t m_phase;
+	// Time the rate condition is due next, 0 for at once
+	uint64_t m_due;
+	// A due scan was held back
+	bool m_pending;
+};
+}
+
+#endif // HLDS_PUBLISHPOLICY_H
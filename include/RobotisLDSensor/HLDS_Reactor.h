@@ -0,0 +1,93 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Reactor.h
+ * @brief I/O event loop shared by the sensors of a process
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_REACTOR_H
+#define HLDS_REACTOR_H
+
+// boost/asio/awaitable.hpp of Boost 1.74 misses <utility> for C++20
+#include <utility>
+#include <boost/asio.hpp>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+
+namespace HLDS
+{
+
+/**
+* @brief One io_service and one thread serving every sensor
+*
+* Serial ports are opened on the shared io_service and read with
+* asynchronous operations, so additional sensors add handlers to the
+* same event loop instead of blocked threads. The thread runs while at
+* least one sensor holds the reactor through acquire().
+*/
+class Reactor
+{
+public:
+	/**
+	* @brief The reactor of this process
+	*/
+	static Reactor& instance();
+
+	boost::asio::io_service& io() { return m_io; }
+
+	/**
+	* @brief Start the event loop thread for the first user
+	*/
+	void acquire();
+	/**
+	* @brief Stop and join the event loop thread after the last user
+	* Must not be called from a handler.
+	*/
+	void release();
+
+private:
+	Reactor();
+	~Reactor();
+	Reactor(const Reactor&);
+	Reactor& operator=(const Reactor&);
+
+	void run();
+
+	boost::asio::io_service m_io;
+	std::unique_ptr<boost::asio::io_service::work> m_work;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	unsigned int m_users;
+};
+}
+
+#endif // HLDS_REACTOR_H
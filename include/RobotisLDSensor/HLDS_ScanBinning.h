@@ -0,0 +1,108 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanBinning.h
+ * @brief Angular binning of a scan to coarser resolutions
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SCANBINNING_H
+#define HLDS_SCANBINNING_H
+
+#include <stddef.h>
+#include <string>
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+
+// Widest bin, in beams
+const size_t MaxBinWidth = 30;
+
+/**
+* @brief How the beams of a bin are reduced to one range
+*
+* Beams without a return (range 0) are ignored, a bin without any
+* return is 0.
+*/
+enum BinMode
+{
+	// Nearest return of the bin
+	BinMin,
+	// Mean of the returns of the bin
+	BinMean,
+	// Return of the beam closest to the bin centre
+	BinNearest
+};
+
+/**
+* @brief Binning settings, computed once per configuration
+*
+* Bin b covers beams b * width to b * width + width - 1. When width does
+* not divide BeamCount the last bin is narrower.
+*/
+struct BinPlan
+{
+	size_t width;
+	size_t bins;
+	BinMode mode;
+	// Beam offsets in the bin by distance to its centre, for BinNearest
+	size_t order[MaxBinWidth];
+};
+
+/**
+* @brief Plan binning by width beams
+* @param width Beams per bin, 0 or 1 disables, at most MaxBinWidth
+*/
+BinPlan makeBinPlan(size_t width, BinMode mode);
+
+/**
+* @brief Whether the plan produces a decimated scan
+*/
+bool binningEnabled(const BinPlan& plan);
+
+/**
+* @brief Bin mode from its name, "min", "mean" or "nearest"
+* @return false if the name is unknown, mode is unchanged
+*/
+bool parseBinMode(const std::string& name, BinMode& mode);
+
+/**
+* @brief Reduce a revolution to plan.bins ranges
+* @param ranges BeamCount ranges, beam i at i degrees
+* @param bins plan.bins ranges, bin b centred on beam
+* b * width + (width - 1) / 2, a fraction for an even width. A narrower
+* last bin is centred on the beams it covers.
+*/
+void binScan(const BinPlan& plan, const double* ranges, double* bins);
+}
+
+#endif // HLDS_SCANBINNING_H
@@ -0,0 +1,136 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanFilter.h
+ * @brief In place filters of a decoded scan
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SCANFILTER_H
+#define HLDS_SCANFILTER_H
+
+#include <stddef.h>
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+
+// Largest neighbourhood on each side of a beam the filters look at
+const size_t MaxShadowWindow = 10;
+
+/**
+* @brief Filter settings, computed once per configuration
+*
+* A filtered beam is set to 0, the value of a beam without a return.
+* Distances are in the unit of the filtered ranges.
+*/
+struct ScanFilterPlan
+{
+	// Beams with a lower intensity are dropped, 0 disables
+	double minIntensity;
+	// Angular median window: 0 (off), 3 or 5 beams
+	size_t medianWindow;
+	// Neighbours on each side checked for veiling, 0 disables
+	size_t shadowWindow;
+	// Veiling test against neighbour k beams away, see shadowFilter()
+	double shadowCos[MaxShadowWindow];
+	double shadowTan[MaxShadowWindow];
+	// Returns farther than this from both neighbours are dropped,
+	// 0 disables
+	double speckleDistance;
+};
+
+/**
+* @brief Plan the filters
+* @param min_intensity Intensity threshold, 0 disables
+* @param median_window Median window, 3 or 5, smaller disables
+* @param shadow_angle Smallest angle in radian between a beam and the
+* surface through its point and a neighbour, 0 disables
+* @param shadow_window Neighbours checked on each side, at most
+* MaxShadowWindow
+* @param speckle_distance Isolated return distance in the unit of the
+* filtered ranges, 0 disables
+* @param increment Angle between beams in radian
+*/
+ScanFilterPlan makeScanFilterPlan(double min_intensity, size_t median_window,
+                                  double shadow_angle, size_t shadow_window,
+                                  double speckle_distance, double increment);
+
+/**
+* @brief Whether the plan enables any filter
+*/
+bool filtersEnabled(const ScanFilterPlan& plan);
+
+/**
+* @brief Run the enabled filters in place on a revolution
+* The order is intensity threshold, median, shadow and speckle removal.
+* Runs the fastest kernels available on this CPU (AVX2, NEON on
+* AArch64, or scalar), chosen on first use; all kernels give bit exact
+* results of the scalar ones.
+* @param ranges BeamCount ranges, adjacent beams are neighbours and the
+* buffer wraps around
+* @param intensities BeamCount intensities in the order of ranges, or
+* NULL to skip the intensity threshold
+*/
+void filterScan(const ScanFilterPlan& plan, double* ranges,
+                const double* intensities);
+
+/**
+* @brief Drop beams below an intensity threshold
+*/
+void intensityFilter(double* ranges, const double* intensities,
+                     double min_intensity);
+/**
+* @brief Replace every beam by the median of the window centred on it
+*/
+void medianFilter(double* ranges, size_t window);
+/**
+* @brief Drop veiling points at object edges
+*
+* A beam whose point lies on a line nearly parallel to the beam with
+* one of its nearer neighbours is a mixed measurement of foreground and
+* background. With r the range, r' the range of the neighbour k beams
+* away and a = k * increment, the angle between the beam and that line
+* is below shadow_angle when |r - r' cos a| > r' sin a / tan(shadow_angle).
+*/
+void shadowFilter(double* ranges, const ScanFilterPlan& plan);
+/**
+* @brief Drop returns farther than the distance from both neighbours
+*/
+void speckleFilter(double* ranges, double max_distance);
+
+/**
+* @brief Name of the kernel used by the filters
+*/
+const char* filterKernel();
+}
+
+#endif // HLDS_SCANFILTER_H
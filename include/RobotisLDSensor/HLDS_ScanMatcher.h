@@ -0,0 +1,154 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanMatcher.h
+ * @brief Scan to scan matching odometry
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SCANMATCHER_H
+#define HLDS_SCANMATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Planar motion of the sensor between two revolutions
+* Pose of the sensor at the later revolution in the frame of the
+* earlier one.
+*/
+struct Motion2D
+{
+	double x;
+	double y;
+	// Radian, counter-clockwise
+	double heading;
+};
+
+/**
+* @brief Point to line ICP between consecutive revolutions
+*
+* Every revolution is matched against the previous one: each point is
+* paired with the nearest point of the previous revolution within the
+* correspondence distance, found through a hashed grid of that cell
+* size, and the distance to the line through that point and its
+* neighbours is minimised by Gauss-Newton steps. The previous motion is
+* the initial guess.
+*
+* All buffers are fixed arrays of BeamCount points laid out by
+* coordinate, nothing is allocated after construction.
+*/
+class ScanMatcher
+{
+public:
+	// Fewest pairs a motion is estimated from
+	enum { MinMatches = 20 };
+
+	ScanMatcher();
+
+	/**
+	* @brief Set the correspondence distance and the iteration limit
+	* Forgets the previous revolution.
+	* @param max_distance Farthest pair of points, in the unit of the
+	* ranges
+	*/
+	void configure(double max_distance, size_t max_iterations);
+
+	/**
+	* @brief Forget the previous revolution
+	*/
+	void reset();
+
+	/**
+	* @brief Match a revolution against the previous one
+	* The revolution becomes the reference of the next match either way.
+	* @param ranges BeamCount ranges, beam i at i degrees
+	* @param motion Motion since the previous revolution
+	* @return false for the first revolution, when fewer than
+	* MinMatches pairs are found or when the scene leaves a direction of
+	* the motion undetermined (a corridor, the centre of a round room),
+	* motion is unchanged
+	*/
+	bool match(const double* ranges, Motion2D& motion);
+
+	/**
+	* @brief Pairs and iterations of the last match
+	*/
+	size_t matches() const { return m_matches; }
+	size_t iterations() const { return m_iterations; }
+
+	/**
+	* @brief RMS point to line distance of the last match
+	*/
+	double rmsError() const { return m_rmsError; }
+
+private:
+	enum { BucketBits = 10, BucketCount = 1 << BucketBits };
+
+	struct Scan
+	{
+		size_t count;
+		double x[BeamCount];
+		double y[BeamCount];
+		// Unit normal of the surface, (0, 0) when it is unknown
+		double nx[BeamCount];
+		double ny[BeamCount];
+		// Points sorted by bucket, bucket b at first[b] to first[b + 1]
+		uint16_t first[BucketCount + 1];
+		uint16_t order[BeamCount];
+	};
+
+	void load(const double* ranges, Scan& scan) const;
+	void index(Scan& scan) const;
+	static double distance2(const Scan& scan, size_t a, size_t b);
+	int32_t cell(double coordinate) const;
+	static uint32_t bucket(int32_t cx, int32_t cy);
+	int nearest(const Scan& scan, double x, double y) const;
+
+	double m_maxDistance;
+	// Cells per unit of range of the bucket grid
+	double m_cellScale;
+	size_t m_maxIterations;
+	Scan m_scans[2];
+	// Index of the previous revolution in m_scans, or -1
+	int m_reference;
+	Motion2D m_guess;
+	size_t m_matches;
+	size_t m_iterations;
+	double m_rmsError;
+};
+}
+
+#endif // HLDS_SCANMATCHER_H
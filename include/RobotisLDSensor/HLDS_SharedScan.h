@@ -0,0 +1,221 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_SharedScan.h
+ * @brief Scan ring in POSIX shared memory for consumers on the same host
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SHAREDSCAN_H
+#define HLDS_SHAREDSCAN_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Consumers build this header and HLDS_SharedScan.cpp on their own, it
+// depends on neither OpenRTM nor the rest of the driver.
+
+
+namespace HLDS
+{
+
+/**
+* @brief Beams of a SharedScan, one revolution of the LDS-01
+*/
+const size_t SharedScanBeams = 360;
+
+/**
+* @brief A revolution as published in the shared memory ring
+*
+* Angles and ranges are those of the RangeData published on the range
+* port, after rotation and filtering.
+*/
+struct SharedScan
+{
+	// Number of the scan, 1 for the first scan written to the ring
+	uint64_t number;
+	// Time stamp of the RangeData
+	uint32_t sec;
+	uint32_t nsec;
+	double minAngle;
+	double angularRes;
+	uint32_t beams;
+	// Whether intensities holds the intensities of the beams
+	uint32_t hasIntensities;
+	// Ranges in metres, 0 for no return. The scale parameter of the
+	// component only applies to its RangeData, not to these.
+	double ranges[SharedScanBeams];
+	double intensities[SharedScanBeams];
+};
+
+/**
+* @brief Layout of the shared memory segment
+*
+* A header followed by a ring of slots, each guarded by a sequence lock:
+* the sequence is odd while the writer fills the slot and even once the
+* slot is complete. A reader copies a slot and accepts the copy if the
+* sequence was even and unchanged across the copy. The writer never
+* waits for readers, and a reader only retries if the writer went once
+* around the whole ring during its copy.
+*/
+namespace SharedScanLayout
+{
+	// "HLDS" in memory order
+	const uint32_t Magic = 0x53444c48;
+	const uint32_t Version = 1;
+
+	struct Header
+	{
+		// Magic once the segment is initialised
+		std::atomic<uint32_t> magic;
+		uint32_t version;
+		uint32_t slots;
+		uint32_t slotSize;
+		// Number of the latest complete scan, 0 before the first one
+		alignas(64) std::atomic<uint64_t> head;
+	};
+
+	struct alignas(64) Slot
+	{
+		std::atomic<uint32_t> sequence;
+		SharedScan scan;
+	};
+
+	inline size_t size(size_t slots)
+	{
+		return sizeof(Header) + slots * sizeof(Slot);
+	}
+}
+
+/**
+* @brief Publisher side of the shared memory scan ring
+*
+* A single process writes to a segment. The segment outlives the writer,
+* so readers keep their mapping across a restart of the component; a
+* writer reopening a segment of the same layout continues its numbering.
+*/
+class SharedScanWriter
+{
+public:
+	SharedScanWriter();
+	~SharedScanWriter();
+
+	/**
+	* @brief Create or reuse the segment and map it
+	* A segment of a different layout is unlinked and created anew.
+	* @param name Segment name, "/" is prepended if missing
+	* @param slots Scans kept in the ring, at least 2
+	* @throw std::runtime_error if the segment cannot be created or mapped
+	*/
+	void open(const std::string& name, size_t slots);
+	/**
+	* @brief Unmap the segment, leaving it for the readers
+	*/
+	void close();
+	bool isOpen() const { return m_header != NULL; }
+	const std::string& name() const { return m_name; }
+
+	/**
+	* @brief The slot of the next scan, marked as being written
+	* Fill it in place and call publish(). number is set by publish().
+	*/
+	SharedScan& beginWrite();
+	/**
+	* @brief Complete the slot of beginWrite() and make it the latest scan
+	*/
+	void publish();
+
+	/**
+	* @brief Remove a segment from the system
+	* Mapped segments stay valid until unmapped.
+	*/
+	static void unlink(const std::string& name);
+
+private:
+	SharedScanWriter(const SharedScanWriter&);
+	SharedScanWriter& operator=(const SharedScanWriter&);
+
+	std::string m_name;
+	SharedScanLayout::Header* m_header;
+	SharedScanLayout::Slot* m_slots;
+	size_t m_size;
+	uint64_t m_number;
+};
+
+/**
+* @brief Consumer side of the shared memory scan ring
+*
+* Maps a segment read-only; any number of readers in any number of
+* processes can read it concurrently. Readers poll, there is no wake-up.
+*/
+class SharedScanReader
+{
+public:
+	SharedScanReader();
+	~SharedScanReader();
+
+	/**
+	* @brief Map a segment created by a SharedScanWriter
+	* @throw std::runtime_error if there is no such segment yet or it has
+	* another layout
+	*/
+	void open(const std::string& name);
+	void close();
+	bool isOpen() const { return m_header != NULL; }
+
+	/**
+	* @brief Copy the latest scan
+	* @return false if no scan has been written yet
+	*/
+	bool latest(SharedScan& scan);
+	/**
+	* @brief Copy the scan after the last one returned
+	* A reader more than a ring behind skips to the oldest scan still in
+	* the ring; scan.number tells how many were missed.
+	* @return false if there is no newer scan
+	*/
+	bool next(SharedScan& scan);
+
+private:
+	SharedScanReader(const SharedScanReader&);
+	SharedScanReader& operator=(const SharedScanReader&);
+
+	bool read(uint64_t number, SharedScan& scan) const;
+
+	const SharedScanLayout::Header* m_header;
+	const SharedScanLayout::Slot* m_slots;
+	size_t m_size;
+	// Number of the last scan returned
+	uint64_t m_last;
+};
+}
+
+#endif // HLDS_SHAREDSCAN_H
@@ -0,0 +1,127 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_SpeedEstimator.h
+ * @brief Rotation speed and revolution period estimation
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SPEEDESTIMATOR_H
+#define HLDS_SPEEDESTIMATOR_H
+
+#include <stdint.h>
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Revolution period from the motor speed fields of the packets
+* The median of the valid packets, in 0.1 rpm units on the wire.
+* @return Period [ns], 0 if no valid packet reports a speed
+*/
+uint64_t reportedPeriod(const RawFrame& frame);
+
+/**
+* @brief Revolution period estimator
+*
+* Tracks the arrival times of the revolutions with an alpha-beta filter
+* in fixed point: each arrival is predicted from the last filtered one
+* and the period, and the residual corrects the phase by 1 / PhaseGain
+* and the period by 1 / PeriodGain. Working on arrival times rather than
+* on intervals, the period settles to a small fraction of the arrival
+* jitter, and gaps of up to MaxTurns lost revolutions fall into place.
+*
+* The speed the sensor reports in its packets seeds the estimate. A
+* residual beyond Tolerance of the period, or a reported speed that far
+* off the one at the start, is rejected; RejectLimit rejections in a row
+* mean the motor speed has changed and the estimate starts over.
+*/
+class SpeedEstimator
+{
+public:
+	static const int64_t PhaseGain = 8;
+	static const int64_t PeriodGain = 128;
+	// Accepted deviation from the estimate in percent
+	static const int64_t Tolerance = 10;
+	static const uint32_t RejectLimit = 8;
+	static const int64_t MaxTurns = 4;
+	// Plausible periods [ns], 60 to 1200 rpm
+	static const uint64_t MinPeriod = 50000000;
+	static const uint64_t MaxPeriod = 1000000000;
+
+	SpeedEstimator();
+
+	/**
+	* @brief Forget the estimate and the last arrival
+	*/
+	void reset();
+
+	/**
+	* @brief Take in a complete revolution
+	* @return The updated period [ns], 0 while unknown
+	*/
+	uint64_t update(const RawFrame& frame);
+
+	/**
+	* @brief Estimated revolution period [ns], 0 while unknown
+	*/
+	uint64_t period() const;
+	/**
+	* @brief Estimated rotation speed [rpm], 0 while unknown
+	*/
+	double rpm() const;
+	/**
+	* @brief Revolutions rejected since construction
+	*/
+	uint64_t rejected() const { return m_rejected; }
+
+private:
+	// Fixed point fraction bits of m_period
+	static const int FractionBits = 8;
+
+	// Start over from seed [ns] arriving at time
+	void restart(uint64_t reported, uint64_t seed, uint64_t time);
+	// Count a rejection, true if the estimate was dropped
+	bool reject();
+
+	// Period in ns, FractionBits fixed point
+	int64_t m_period;
+	// Filtered arrival of the last revolution, monotonicNow()
+	uint64_t m_phase;
+	// Reported period at the start of the estimate, 0 for none
+	uint64_t m_reported;
+	uint32_t m_misses;
+	uint64_t m_rejected;
+};
+}
+
+#endif // HLDS_SPEEDESTIMATOR_H
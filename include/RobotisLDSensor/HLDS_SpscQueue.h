@@ -0,0 +1,110 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_SpscQueue.h
+ * @brief Lock-free single producer / single consumer queue
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SPSCQUEUE_H
+#define HLDS_SPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Bounded lock-free queue between one writer and one reader thread
+*
+* push() never blocks, it fails when the queue is full so that a slow
+* reader can never stall the writer.
+* @param Capacity Number of slots, a power of two
+*/
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0,
+	              "Capacity must be a power of two");
+public:
+	SpscQueue() : m_head(0), m_tail(0) {}
+
+	/**
+	* @brief Append a value, writer side
+	* @return false if the queue is full and the value was dropped
+	*/
+	bool push(const T& value)
+	{
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+		m_slots[tail & (Capacity - 1)] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	* @brief Take the oldest value, reader side
+	* @return false if the queue is empty
+	*/
+	bool pop(T& value)
+	{
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		value = m_slots[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	* @brief Drop all queued values, reader side
+	*/
+	void clear()
+	{
+		m_head.store(m_tail.load(std::memory_order_acquire),
+		             std::memory_order_release);
+	}
+
+private:
+	T m_slots[Capacity];
+	// Free running read position, written by the reader
+	alignas(64) std::atomic<size_t> m_head;
+	// Free running write position, written by the writer
+	alignas(64) std::atomic<size_t> m_tail;
+};
+}
+
+#endif // HLDS_SPSCQUEUE_H
@@ -0,0 +1,114 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_TripleBuffer.h
+ * @brief Wait-free single producer / single consumer triple buffer
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_TRIPLEBUFFER_H
+#define HLDS_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+
+namespace HLDS
+{
+
+/**
+* @brief Wait-free triple buffer between one writer and one reader thread
+*
+* The writer fills writeBuffer() and calls publish(), the reader calls
+* update() and then reads readBuffer(). Neither side ever blocks: the
+* three slots are exchanged through a single atomic index, so the reader
+* always gets the most recently published value and the writer never
+* has to wait for a slow reader.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+	  : m_middle(1), m_back(0), m_front(2)
+	{
+	}
+
+	/**
+	* @brief The slot owned by the writer
+	*/
+	T& writeBuffer() { return m_slots[m_back]; }
+
+	/**
+	* @brief Hand the write slot over to the reader side
+	* The previous middle slot becomes the new write slot.
+	*/
+	void publish()
+	{
+		uint8_t prev = m_middle.exchange(m_back | Fresh,
+		                                 std::memory_order_acq_rel);
+		m_back = prev & IndexMask;
+	}
+
+	/**
+	* @brief Swap in the newest published slot, if any
+	* @return true if readBuffer() now refers to a new value
+	*/
+	bool update()
+	{
+		if ((m_middle.load(std::memory_order_relaxed) & Fresh) == 0)
+		{
+			return false;
+		}
+		uint8_t prev = m_middle.exchange(m_front,
+		                                 std::memory_order_acq_rel);
+		m_front = prev & IndexMask;
+		return true;
+	}
+
+	/**
+	* @brief The slot owned by the reader
+	*/
+	T& readBuffer() { return m_slots[m_front]; }
+	const T& readBuffer() const { return m_slots[m_front]; }
+
+private:
+	enum { IndexMask = 0x03, Fresh = 0x04 };
+
+	T m_slots[3];
+	// Index of the slot in flight, plus the Fresh flag
+	alignas(64) std::atomic<uint8_t> m_middle;
+	// Writer-side slot index
+	alignas(64) uint8_t m_back;
+	// Reader-side slot index
+	alignas(64) uint8_t m_front;
+};
+}
+
+#endif // HLDS_TRIPLEBUFFER_H
@@ -1,315 +1,802 @@
-﻿// -*- C++ -*-
-/*!
- * @file  RobotisLDSensor.h
- * @brief Robotis LDS-01 RTC
- * @date  $Date$
- *
- * $Id$
- */
-
-#ifndef ROBOTISLDSENSOR_H
-#define ROBOTISLDSENSOR_H
-
-#include <rtm/idl/BasicDataTypeSkel.h>
-#include <rtm/idl/ExtendedDataTypesSkel.h>
-#include <rtm/idl/InterfaceDataTypesSkel.h>
-
-// Service implementation headers
-// <rtc-template block="service_impl_h">
-
-// </rtc-template>
-
-// Service Consumer stub headers
-// <rtc-template block="consumer_stub_h">
-#include "InterfaceDataTypesStub.h"
-
-// </rtc-template>
-
-#include <rtm/Manager.h>
-#include <rtm/DataFlowComponentBase.h>
-#include <rtm/CorbaPort.h>
-#include <rtm/DataInPort.h>
-#include <rtm/DataOutPort.h>
-
-#include <HLDS_LDSensor.h>
-/*!
- * @class RobotisLDSensor
- * @brief Robotis LDS-01 RTC
- *
- */
-class RobotisLDSensor
-  : public RTC::DataFlowComponentBase
-{
- public:
-  /*!
-   * @brief constructor
-   * @param manager Maneger Object
-   */
-  RobotisLDSensor(RTC::Manager* manager);
-
-  /*!
-   * @brief destructor
-   */
-  ~RobotisLDSensor();
-
-  // <rtc-template block="public_attribute">
-  
-  // </rtc-template>
-
-  // <rtc-template block="public_operation">
-  
-  // </rtc-template>
-
-  /***
-   *
-   * The initialize action (on CREATED->ALIVE transition)
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-   virtual RTC::ReturnCode_t onInitialize();
-
-  /***
-   *
-   * The finalize action (on ALIVE->END transition)
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onFinalize();
-
-  /***
-   *
-   * The startup action when ExecutionContext startup
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The shutdown action when ExecutionContext stop
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The activated action (Active state entry action)
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-   virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The deactivated action (Active state exit action)
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-   virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The execution action that is invoked periodically
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-   virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The aborting action when main logic error occurred.
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The error action in ERROR state
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The reset action that is invoked resetting
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-   virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
-  
-  /***
-   *
-   * The state update action that is invoked after onExecute() action
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
-
-  /***
-   *
-   * The action that is invoked when execution context's rate is changed
-   *
-   * @param ec_id target ExecutionContext Id
-   *
-   * @return RTC::ReturnCode_t
-   * 
-   * 
-   */
-  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
-
-
- protected:
-  // <rtc-template block="protected_attribute">
-  
-  // </rtc-template>
-
-  // <rtc-template block="protected_operation">
-  
-  // </rtc-template>
-
-  // Configuration variable declaration
-  // <rtc-template block="config_declare">
-  /*!
-   * 
-   * - Name:  port_name
-   * - DefaultValue: /dev/ttyUSB0
-   */
-  std::string m_port_name;
-  /*!
-   * 
-   * - Name:  baudrate
-   * - DefaultValue: 230400
-   */
-  int m_baudrate;
-  /*!
-   * 
-   * - Name:  debug
-   * - DefaultValue: 0
-   */
-  int m_debug;
-  /*!
-   * 
-   * - Name:  scale
-   * - DefaultValue: 1.0
-   */
-  float m_scale;
-  /*!
-   * 
-   * - Name:  offset
-   * - DefaultValue: 5.0
-   */
-  double m_offset;
-  /*!
-   * 
-   * - Name:  geometry_x
-   * - DefaultValue: 0.0
-   */
-  double m_geometry_x;
-  /*!
-   * 
-   * - Name:  geometry_y
-   * - DefaultValue: 0.0
-   */
-  double m_geometry_y;
-  /*!
-   * 
-   * - Name:  geometry_z
-   * - DefaultValue: 0.0
-   */
-  double m_geometry_z;
-
-  // </rtc-template>
-
-  // DataInPort declaration
-  // <rtc-template block="inport_declare">
-  
-  // </rtc-template>
-
-
-  // DataOutPort declaration
-  // <rtc-template block="outport_declare">
-  RTC::RangeData m_range;
-  /*!
-   */
-  RTC::OutPort<RTC::RangeData> m_rangeOut;
-  
-  // </rtc-template>
-
-  // CORBA Port declaration
-  // <rtc-template block="corbaport_declare">
-  
-  // </rtc-template>
-
-  // Service declaration
-  // <rtc-template block="service_declare">
-  
-  // </rtc-template>
-
-  // Consumer declaration
-  // <rtc-template block="consumer_declare">
-  
-  // </rtc-template>
-
- private:
-  HLDS::LDSensor* m_ldsensor;
-  boost::asio::io_service m_io;
-  // <rtc-template block="private_attribute">
-  
-  // </rtc-template>
-
-  // <rtc-template block="private_operation">
-  
-  // </rtc-template>
-
-};
-
-
-extern "C"
-{
-  DLL_EXPORT void RobotisLDSensorInit(RTC::Manager* manager);
-};
-
-#endif // ROBOTISLDSENSOR_H
+﻿// -*- C++ -*-
+/*!
+ * @file  RobotisLDSensor.h
+ * @brief Robotis LDS-01 RTC
+ * @date  $Date$
+ *
+ * $Id$
+ */
+
+#ifndef ROBOTISLDSENSOR_H
+#define ROBOTISLDSENSOR_H
+
+#include <rtm/idl/BasicDataTypeSkel.h>
+#include <rtm/idl/ExtendedDataTypesSkel.h>
+#include <rtm/idl/InterfaceDataTypesSkel.h>
+
+// Service implementation headers
+// <rtc-template block="service_impl_h">
+
+// </rtc-template>
+
+// Service Consumer stub headers
+// <rtc-template block="consumer_stub_h">
+#include "InterfaceDataTypesStub.h"
+#include "CompactScanStub.h"
+
+// </rtc-template>
+
+#include <rtm/Manager.h>
+#include <rtm/DataFlowComponentBase.h>
+#include <rtm/CorbaPort.h>
+#include <rtm/DataInPort.h>
+#include <rtm/DataOutPort.h>
+
+#include <HLDS_Capture.h>
+#include <HLDS_CompactScan.h>
+#include <HLDS_LDSensor.h>
+#include <HLDS_OccupancyGrid.h>
+#include <HLDS_PointCloud.h>
+#include <HLDS_PublishPolicy.h>
+#include <HLDS_ScanBinning.h>
+#include <HLDS_ScanFilter.h>
+#include <HLDS_ScanMatcher.h>
+#include <HLDS_SharedScan.h>
+#include <atomic>
+
+/*!
+ * @class PlanListener
+ * @brief Marks a precomputed plan for recomputation when one of the
+ * parameters it is derived from is updated
+ */
+class PlanListener
+  : public RTC::ConfigurationParamListener
+{
+public:
+  /*!
+   * @param dirty Flag set on update, cleared by the plan owner
+   * @param names NULL terminated list of the watched parameters
+   */
+  PlanListener(std::atomic<bool>& dirty, const char* const* names)
+    : m_dirty(dirty), m_names(names) {}
+  virtual void operator()(const char* config_set_name,
+                          const char* config_param_name);
+private:
+  std::atomic<bool>& m_dirty;
+  const char* const* m_names;
+};
+
+/*!
+ * @class RobotisLDSensor
+ * @brief Robotis LDS-01 RTC
+ *
+ */
+class RobotisLDSensor
+  : public RTC::DataFlowComponentBase
+{
+ public:
+  /*!
+   * @brief constructor
+   * @param manager Maneger Object
+   */
+  RobotisLDSensor(RTC::Manager* manager);
+
+  /*!
+   * @brief destructor
+   */
+  ~RobotisLDSensor();
+
+  // <rtc-template block="public_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="public_operation">
+  
+  // </rtc-template>
+
+  /***
+   *
+   * The initialize action (on CREATED->ALIVE transition)
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onInitialize();
+
+  /***
+   *
+   * The finalize action (on ALIVE->END transition)
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  virtual RTC::ReturnCode_t onFinalize();
+
+  /***
+   *
+   * The startup action when ExecutionContext startup
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStartup(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The shutdown action when ExecutionContext stop
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onShutdown(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The activated action (Active state entry action)
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onActivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The deactivated action (Active state exit action)
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onDeactivated(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The execution action that is invoked periodically
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onExecute(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The aborting action when main logic error occurred.
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onAborting(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The error action in ERROR state
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onError(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The reset action that is invoked resetting
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+   virtual RTC::ReturnCode_t onReset(RTC::UniqueId ec_id);
+  
+  /***
+   *
+   * The state update action that is invoked after onExecute() action
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onStateUpdate(RTC::UniqueId ec_id);
+
+  /***
+   *
+   * The action that is invoked when execution context's rate is changed
+   *
+   * @param ec_id target ExecutionContext Id
+   *
+   * @return RTC::ReturnCode_t
+   * 
+   * 
+   */
+  // virtual RTC::ReturnCode_t onRateChanged(RTC::UniqueId ec_id);
+
+
+ protected:
+  // <rtc-template block="protected_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="protected_operation">
+  
+  // </rtc-template>
+
+  // Configuration variable declaration
+  // <rtc-template block="config_declare">
+  /*!
+   * 
+   * - Name:  port_name
+   * - DefaultValue: /dev/ttyUSB0
+   */
+  std::string m_port_name;
+  /*!
+   * 
+   * - Name:  baudrate
+   * - DefaultValue: 230400
+   */
+  int m_baudrate;
+  /*!
+   * 
+   * - Name:  debug
+   * - DefaultValue: 0
+   */
+  int m_debug;
+  /*!
+   * 
+   * - Name:  scale
+   * - DefaultValue: 1.0
+   */
+  float m_scale;
+  /*!
+   * 
+   * - Name:  offset
+   * - DefaultValue: 5.0
+   */
+  double m_offset;
+  /*!
+   * 
+   * - Name:  geometry_x
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_x;
+  /*!
+   * 
+   * - Name:  geometry_y
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_y;
+  /*!
+   * 
+   * - Name:  geometry_z
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_z;
+
+  /*!
+   * Publish every 6 degree packet on the sector port
+   * - Name:  sector_output
+   * - DefaultValue: 0
+   */
+  int m_sector_output;
+  /*!
+   * Packet checksum verification. Packets with a wrong checksum are output as 0.
+   * - Name:  verify_checksum
+   * - DefaultValue: 1
+   */
+  int m_verify_checksum;
+  /*!
+   * File the raw serial stream is recorded to, empty for no recording
+   * - Name:  capture_file
+   * - DefaultValue: 
+   */
+  std::string m_capture_file;
+  /*!
+   * Replay speed of a replay:<file> port_name relative to real time, 0 for as fast as possible
+   * - Name:  replay_speed
+   * - DefaultValue: 1.0
+   */
+  double m_replay_speed;
+  /*!
+   * Raw termios mode with serial_vmin/serial_vtime, no line discipline processing
+   * - Name:  serial_raw
+   * - DefaultValue: 1
+   */
+  int m_serial_raw;
+  /*!
+   * Minimum number of bytes a read waits for in raw mode (VMIN)
+   * - Name:  serial_vmin
+   * - DefaultValue: 1
+   */
+  int m_serial_vmin;
+  /*!
+   * Inter-byte timeout of a read in raw mode in 0.1 s units (VTIME)
+   * - Name:  serial_vtime
+   * - DefaultValue: 0
+   */
+  int m_serial_vtime;
+  /*!
+   * ASYNC_LOW_LATENCY serial flag, shortens the latency timer of USB serial adapters
+   * - Name:  serial_low_latency
+   * - DefaultValue: 1
+   */
+  int m_serial_low_latency;
+  /*!
+   * Driver receive buffer size [bytes] (Windows), 0 for the driver default
+   * - Name:  serial_rx_buffer
+   * - DefaultValue: 0
+   */
+  int m_serial_rx_buffer;
+  /*!
+   * Driver transmit buffer size [bytes] (Windows), 0 for the driver default
+   * - Name:  serial_tx_buffer
+   * - DefaultValue: 0
+   */
+  int m_serial_tx_buffer;
+  /*!
+   * Ranges of returns weaker than this are cleared, 0 to disable
+   * - Name:  filter_min_intensity
+   * - DefaultValue: 0.0
+   */
+  double m_filter_min_intensity;
+  /*!
+   * Median filter window in beams, 0 to disable
+   * - Name:  filter_median
+   * - DefaultValue: 0
+   */
+  int m_filter_median;
+  /*!
+   * Veiling (shadow) filter angle threshold [deg], 0 to disable
+   * - Name:  filter_shadow_angle
+   * - DefaultValue: 0.0
+   */
+  double m_filter_shadow_angle;
+  /*!
+   * Neighbours checked on each side by the shadow filter
+   * - Name:  filter_shadow_window
+   * - DefaultValue: 1
+   */
+  int m_filter_shadow_window;
+  /*!
+   * Isolated ranges further than this [m] from both neighbours are cleared, 0 to disable
+   * - Name:  filter_speckle_distance
+   * - DefaultValue: 0.0
+   */
+  double m_filter_speckle_distance;
+  /*!
+   * Mount roll about the robot x axis [deg]
+   * - Name:  geometry_roll
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_roll;
+  /*!
+   * Mount pitch about the robot y axis [deg]
+   * - Name:  geometry_pitch
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_pitch;
+  /*!
+   * Mount yaw about the robot z axis [deg]
+   * - Name:  geometry_yaw
+   * - DefaultValue: 0.0
+   */
+  double m_geometry_yaw;
+  /*!
+   * Publish the revolution as points in the robot frame
+   * - Name:  point_cloud_output
+   * - DefaultValue: 0
+   */
+  int m_point_cloud_output;
+  /*!
+   * Beams per bin of the range_bin0 port, 0 disables
+   * - Name:  bin0_width
+   * - DefaultValue: 0
+   */
+  int m_bin0_width;
+  /*!
+   * Reduction of the beams of a range_bin0 bin
+   * - Name:  bin0_mode
+   * - DefaultValue: min
+   */
+  std::string m_bin0_mode;
+  /*!
+   * Beams per bin of the range_bin1 port, 0 disables
+   * - Name:  bin1_width
+   * - DefaultValue: 0
+   */
+  int m_bin1_width;
+  /*!
+   * Reduction of the beams of a range_bin1 bin
+   * - Name:  bin1_mode
+   * - DefaultValue: min
+   */
+  std::string m_bin1_mode;
+  /*!
+   * Publish a local occupancy grid updated by every revolution
+   * - Name:  grid_output
+   * - DefaultValue: 0
+   */
+  int m_grid_output;
+  /*!
+   * Cells along each side of the occupancy grid
+   * - Name:  grid_size
+   * - DefaultValue: 160
+   */
+  int m_grid_size;
+  /*!
+   * Side of an occupancy grid cell [m]
+   * - Name:  grid_resolution
+   * - DefaultValue: 0.05
+   */
+  double m_grid_resolution;
+  /*!
+   * Publish the motion of the sensor between revolutions by scan matching
+   * - Name:  odometry_output
+   * - DefaultValue: 0
+   */
+  int m_odometry_output;
+  /*!
+   * Farthest pair of points matched between revolutions [m]
+   * - Name:  odometry_max_distance
+   * - DefaultValue: 0.3
+   */
+  double m_odometry_max_distance;
+  /*!
+   * Iteration limit of the scan matching
+   * - Name:  odometry_iterations
+   * - DefaultValue: 20
+   */
+  int m_odometry_iterations;
+  /*!
+   * Publish the revolution as a 16 bit CompactScan
+   * - Name:  compact_output
+   * - DefaultValue: 0
+   */
+  int m_compact_output;
+  /*!
+   * CompactScan encoding, raw values or differences to the previous scan
+   * - Name:  compact_encoding
+   * - DefaultValue: delta
+   */
+  std::string m_compact_encoding;
+  /*!
+   * Scans from one delta coded key frame to the next
+   * - Name:  compact_key_interval
+   * - DefaultValue: 10
+   */
+  int m_compact_key_interval;
+  /*!
+   * Include the intensities in the CompactScan
+   * - Name:  compact_intensities
+   * - DefaultValue: 0
+   */
+  int m_compact_intensities;
+  /*!
+   * Write revolutions to a shared memory ring for local consumers
+   * - Name:  shared_output
+   * - DefaultValue: 0
+   */
+  int m_shared_output;
+  /*!
+   * Name of the shared memory segment, read on activation, empty for the
+   * instance name
+   * - Name:  shared_name
+   * - DefaultValue: 
+   */
+  std::string m_shared_name;
+  /*!
+   * Revolutions kept in the shared memory ring, read on activation
+   * - Name:  shared_slots
+   * - DefaultValue: 4
+   */
+  int m_shared_slots;
+  /*!
+   * When the range port publishes, a comma separated list of all,
+   * every:N, rate:HZ and latest
+   * - Name:  publish_range
+   * - DefaultValue: all
+   */
+  std::string m_publish_range;
+  /*!
+   * When the sector port publishes, as publish_range
+   * - Name:  publish_sector
+   * - DefaultValue: all
+   */
+  std::string m_publish_sector;
+  /*!
+   * When the beam_time port publishes, as publish_range
+   * - Name:  publish_beam_time
+   * - DefaultValue: all
+   */
+  std::string m_publish_beam_time;
+  /*!
+   * When the point_cloud port publishes, as publish_range
+   * - Name:  publish_point_cloud
+   * - DefaultValue: all
+   */
+  std::string m_publish_point_cloud;
+  /*!
+   * When the range_bin0 port publishes, as publish_range
+   * - Name:  publish_range_bin0
+   * - DefaultValue: all
+   */
+  std::string m_publish_range_bin0;
+  /*!
+   * When the range_bin1 port publishes, as publish_range
+   * - Name:  publish_range_bin1
+   * - DefaultValue: all
+   */
+  std::string m_publish_range_bin1;
+  /*!
+   * When the grid port publishes, as publish_range
+   * - Name:  publish_grid
+   * - DefaultValue: all
+   */
+  std::string m_publish_grid;
+  /*!
+   * When the odometry port publishes, as publish_range
+   * - Name:  publish_odometry
+   * - DefaultValue: all
+   */
+  std::string m_publish_odometry;
+  /*!
+   * When the compact port publishes, as publish_range
+   * - Name:  publish_compact
+   * - DefaultValue: all
+   */
+  std::string m_publish_compact;
+  // </rtc-template>
+
+  // DataInPort declaration
+  // <rtc-template block="inport_declare">
+  
+  // </rtc-template>
+
+
+  // DataOutPort declaration
+  // <rtc-template block="outport_declare">
+  RTC::RangeData m_range;
+  /*!
+   */
+  RTC::OutPort<RTC::RangeData> m_rangeOut;
+  
+  RTC::RangeData m_sector;
+  /*!
+   */
+  RTC::OutPort<RTC::RangeData> m_sectorOut;
+  
+  RTC::TimedDoubleSeq m_beamTime;
+  /*!
+   */
+  RTC::OutPort<RTC::TimedDoubleSeq> m_beamTimeOut;
+  
+  RTC::PointCloud m_pointCloud;
+  /*!
+   */
+  RTC::OutPort<RTC::PointCloud> m_pointCloudOut;
+  
+  RTC::RangeData m_rangeBin0;
+  /*!
+   */
+  RTC::OutPort<RTC::RangeData> m_rangeBin0Out;
+  
+  RTC::RangeData m_rangeBin1;
+  /*!
+   */
+  RTC::OutPort<RTC::RangeData> m_rangeBin1Out;
+  
+  RTC::CameraImage m_grid;
+  /*!
+   */
+  RTC::OutPort<RTC::CameraImage> m_gridOut;
+  
+  RTC::TimedPose2D m_odometry;
+  /*!
+   */
+  RTC::OutPort<RTC::TimedPose2D> m_odometryOut;
+  
+  RobotisLDS::CompactScan m_compact;
+  /*!
+   */
+  RTC::OutPort<RobotisLDS::CompactScan> m_compactOut;
+  
+  // </rtc-template>
+
+  // CORBA Port declaration
+  // <rtc-template block="corbaport_declare">
+  
+  // </rtc-template>
+
+  // Service declaration
+  // <rtc-template block="service_declare">
+  
+  // </rtc-template>
+
+  // Consumer declaration
+  // <rtc-template block="consumer_declare">
+  
+  // </rtc-template>
+
+ private:
+  HLDS::LDSensor* m_ldsensor;
+  boost::asio::io_service m_io;
+  // Stage latencies after the frame is complete: pick up by onExecute,
+  // decode, scan filters, point conversion, binning, grid update, scan
+  // matching, compact coding, OutPort write, and all of them together
+  HLDS::LatencyHistogram m_handoffLatency;
+  HLDS::LatencyHistogram m_decodeLatency;
+  HLDS::LatencyHistogram m_filterLatency;
+  HLDS::LatencyHistogram m_pointLatency;
+  HLDS::LatencyHistogram m_binLatency;
+  HLDS::LatencyHistogram m_gridLatency;
+  HLDS::LatencyHistogram m_odometryLatency;
+  HLDS::LatencyHistogram m_compactLatency;
+  HLDS::LatencyHistogram m_sharedLatency;
+  HLDS::LatencyHistogram m_publishLatency;
+  HLDS::LatencyHistogram m_totalLatency;
+  // Rotation by offset and scaling, recomputed when they change
+  HLDS::RotationPlan m_plan;
+  std::atomic<bool> m_planDirty;
+  // Scan filter thresholds, recomputed when the filter_* parameters change
+  HLDS::ScanFilterPlan m_filterPlan;
+  std::atomic<bool> m_filterDirty;
+  // Intensities of the latest revolution, decoded for the intensity filter
+  double m_intensities[HLDS::BeamCount];
+  // Ranges of the latest revolution in metres, m_range holds them
+  // multiplied by scale. Filled by metres() on first use.
+  double m_metres[HLDS::BeamCount];
+  bool m_metresValid;
+  // Sensor mount on the robot, recomputed when the geometry_* parameters
+  // change, and the points of the latest revolution
+  HLDS::MountTransform m_mount;
+  std::atomic<bool> m_mountDirty;
+  HLDS::PointScan m_points;
+  // Binning of the range_bin0 and range_bin1 ports, recomputed when the
+  // bin* parameters change
+  HLDS::BinPlan m_binPlan[2];
+  std::atomic<bool> m_binDirty;
+  // Occupancy grid around the sensor, rebuilt when its size or
+  // resolution changes
+  HLDS::OccupancyGrid m_occupancy;
+  std::atomic<bool> m_gridDirty;
+  // Scan to scan matching, reconfigured when the odometry_* parameters
+  // change
+  HLDS::ScanMatcher m_matcher;
+  std::atomic<bool> m_matcherDirty;
+  // Delta coder of the compact port and the millimetre ranges and
+  // intensities it codes
+  HLDS::CompactEncoder m_compactEncoder;
+  uint16_t m_compactRanges[HLDS::BeamCount];
+  uint16_t m_compactIntensities[HLDS::BeamCount];
+  // Shared memory ring for consumers on this host, opened on the first
+  // revolution with shared_output set and closed on deactivation. An
+  // open failure is reported once per activation.
+  HLDS::SharedScanWriter m_sharedWriter;
+  bool m_sharedFailed;
+  // Publication policy of each port, recomputed when the publish_*
+  // parameters change
+  enum PublishPort
+  {
+    PublishRange, PublishSector, PublishBeamTime, PublishPointCloud,
+    PublishRangeBin0, PublishRangeBin1, PublishGrid, PublishOdometry,
+    PublishCompact, PublishPortCount
+  };
+  HLDS::PublishGate m_publishGate[PublishPortCount];
+  std::atomic<bool> m_publishDirty;
+  // <rtc-template block="private_attribute">
+  
+  // </rtc-template>
+
+  // <rtc-template block="private_operation">
+  
+  // </rtc-template>
+
+  /*!
+   * @brief Publish one packet on the sector port, rotated by m_plan
+   */
+  void writeSector(const HLDS::Sector& sector);
+  /*!
+   * @brief Compute m_plan from the offset and scale parameters
+   */
+  void updateRotationPlan();
+  /*!
+   * @brief Compute m_filterPlan from the filter_* parameters
+   */
+  void updateFilterPlan();
+  /*!
+   * @brief Compute m_mount and the port geometries from the geometry_*
+   * parameters
+   */
+  void updateMount();
+  /*!
+   * @brief Ranges of the revolution in m_range in metres
+   * The scale parameter only applies to the published ranges, stages
+   * with metric parameters work on these.
+   */
+  const double* metres();
+  /*!
+   * @brief Publish the revolution in m_range on the point cloud port
+   */
+  void writePointCloud();
+  /*!
+   * @brief Compute m_binPlan from the bin* parameters
+   */
+  void updateBinPlans();
+  /*!
+   * @brief Rebuild m_occupancy and size the grid image from the grid_*
+   * parameters
+   */
+  void updateGrid();
+  /*!
+   * @brief Reconfigure m_matcher from the odometry_* parameters
+   */
+  void updateMatcher();
+  /*!
+   * @brief Match the revolution in m_range against the previous one and
+   * publish the motion
+   */
+  void writeOdometry();
+  /*!
+   * @brief Publish the revolution in m_range on the compact port
+   * @param intensities Intensities of the revolution, or NULL
+   */
+  void writeCompact(const double* intensities);
+  /*!
+   * @brief Write the revolution in m_range to the shared memory ring
+   * @param intensities Intensities of the revolution, or NULL
+   */
+  void writeShared(const double* intensities);
+  /*!
+   * @brief Compute m_publishGate policies from the publish_* parameters
+   */
+  void updatePublishPolicies();
+  /*!
+   * @brief Whether the policy of port lets the current scan out
+   * Ports ask before doing any work for the scan.
+   */
+  bool admit(PublishPort port, RTC::OutPortBase& out);
+  /*!
+   * @brief Whether a connector of port still holds the previous scan
+   */
+  bool consumerBusy(RTC::OutPortBase& port);
+  /*!
+   * @brief Publish the revolution in m_range binned by plan on port
+   */
+  void writeBinned(const HLDS::BinPlan& plan, RTC::RangeData& binned,
+                   RTC::OutPort<RTC::RangeData>& port);
+  /*!
+   * @brief One line summary per latency stage and of the packet jitter
+   */
+  std::vector<std::string> latencyReport() const;
+
+};
+
+
+extern "C"
+{
+  DLL_EXPORT void RobotisLDSensorInit(RTC::Manager* manager);
+};
+
+#endif // ROBOTISLDSENSOR_H
@@ -0,0 +1,175 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ByteSource.cpp
+ * @brief Byte stream transports of the LDS driver
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_ByteSource.h>
+#include <HLDS_Capture.h>
+#include <HLDS_Reactor.h>
+#include <future>
+#include <iostream>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#if defined(__linux__)
+#include <linux/serial.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+
+namespace HLDS
+{
+
+SerialSource::SerialSource(const std::string& port, uint32_t baud_rate,
+                           const SerialOptions& options)
+  : m_serial(Reactor::instance().io(), port)
+{
+    m_serial.set_option(boost::asio::serial_port_base::baud_rate(baud_rate));
+    configure(port, options);
+    Reactor::instance().acquire();
+}
+
+SerialSource::~SerialSource()
+{
+    // Closed on the reactor thread, after any cancel() still queued
+    std::promise<void> closed;
+    Reactor::instance().io().post([this, &closed]()
+    {
+        boost::system::error_code ec;
+        m_serial.close(ec);
+        closed.set_value();
+    });
+    closed.get_future().wait();
+    Reactor::instance().release();
+}
+
+void SerialSource::configure(const std::string& port,
+                             const SerialOptions& options)
+{
+#if !defined(_WIN32)
+    int fd = m_serial.native_handle();
+    if (options.raw)
+    {
+        struct termios tio;
+        if (tcgetattr(fd, &tio) != 0)
+        {
+            throw boost::system::system_error(errno,
+                boost::system::system_category(), "tcgetattr " + port);
+        }
+        // cfmakeraw() keeps the baud rate
+        cfmakeraw(&tio);
+        tio.c_cflag |= CREAD | CLOCAL;
+        tio.c_cc[VMIN] = options.vmin;
+        tio.c_cc[VTIME] = options.vtime;
+        if (tcsetattr(fd, TCSANOW, &tio) != 0)
+        {
+            throw boost::system::system_error(errno,
+                boost::system::system_category(), "tcsetattr " + port);
+        }
+    }
+#if defined(__linux__)
+    if (options.lowLatency)
+    {
+        // Not every driver has the flag (pseudo terminals do not), the
+        // port works without it
+        struct serial_struct serial;
+        bool set = ioctl(fd, TIOCGSERIAL, &serial) == 0;
+        if (set)
+        {
+            serial.flags |= ASYNC_LOW_LATENCY;
+            set = ioctl(fd, TIOCSSERIAL, &serial) == 0;
+        }
+        if (!set)
+        {
+            std::cerr << "SerialSource: " << port
+                      << ": ASYNC_LOW_LATENCY not set: " << strerror(errno)
+                      << std::endl;
+        }
+    }
+#endif
+#else
+    if (options.rxBufferSize != 0 || options.txBufferSize != 0)
+    {
+        // Both sizes are required, 4096 is the usual driver default
+        DWORD rx = options.rxBufferSize != 0 ? options.rxBufferSize : 4096;
+        DWORD tx = options.txBufferSize != 0 ? options.txBufferSize : 4096;
+        if (!SetupComm(m_serial.native_handle(), rx, tx))
+        {
+            throw boost::system::system_error(GetLastError(),
+                boost::system::system_category(), "SetupComm " + port);
+        }
+    }
+#endif
+}
+
+size_t SerialSource::read(uint8_t* buffer, size_t length)
+{
+    return m_serial.read_some(boost::asio::buffer(buffer, length));
+}
+
+void SerialSource::write(const uint8_t* data, size_t length)
+{
+    boost::asio::write(m_serial, boost::asio::buffer(data, length));
+}
+
+void SerialSource::asyncRead(uint8_t* buffer, size_t length,
+                             const ReadHandler& handler)
+{
+    m_serial.async_read_some(boost::asio::buffer(buffer, length), handler);
+}
+
+void SerialSource::cancel()
+{
+    // The port is only touched by the reactor thread while reading
+    Reactor::instance().io().post([this]()
+    {
+        boost::system::error_code ec;
+        m_serial.cancel(ec);
+    });
+}
+
+ByteSource* openByteSource(const std::string& port, uint32_t baud_rate,
+                           double replay_speed, const SerialOptions& options)
+{
+    const std::string prefix(ReplayPrefix);
+    if (port.compare(0, prefix.size(), prefix) == 0)
+    {
+        return new ReplaySource(port.substr(prefix.size()), replay_speed);
+    }
+    return new SerialSource(port, baud_rate, options);
+}
+
+}
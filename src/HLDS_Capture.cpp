@@ -0,0 +1,266 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Capture.cpp
+ * @brief Raw byte stream capture and replay
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_Capture.h>
+#include <algorithm>
+#include <errno.h>
+#include <iostream>
+#include <stdexcept>
+#include <string.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace HLDS
+{
+
+namespace
+{
+std::runtime_error fileError(const std::string& what,
+                             const std::string& path)
+{
+    return std::runtime_error(what + " " + path + ": " + strerror(errno));
+}
+
+void putLE(uint8_t* dst, uint64_t value, size_t length)
+{
+    for (size_t i = 0; i < length; ++i, value >>= 8)
+    {
+        dst[i] = uint8_t(value);
+    }
+}
+
+uint64_t getLE(const uint8_t* src, size_t length)
+{
+    uint64_t value = 0;
+    for (size_t i = length; i > 0; --i)
+    {
+        value = (value << 8) | src[i - 1];
+    }
+    return value;
+}
+}
+
+RecordingSource::RecordingSource(ByteSource* source, const std::string& path,
+                                 uint32_t baud_rate)
+  : m_source(source), m_path(path), m_file(NULL),
+    m_start(std::chrono::steady_clock::now())
+{
+    m_file = fopen(path.c_str(), "wb");
+    if (m_file == NULL) { throw fileError("cannot create", path); }
+
+    uint8_t header[CaptureHeaderLength] = { 0 };
+    memcpy(header, CaptureMagic, sizeof(CaptureMagic));
+    putLE(header + 8, baud_rate, 4);
+    append(header, sizeof(header));
+}
+
+RecordingSource::~RecordingSource()
+{
+    if (m_file != NULL) { fclose(m_file); }
+}
+
+size_t RecordingSource::read(uint8_t* buffer, size_t length)
+{
+    size_t n = m_source->read(buffer, length);
+    if (n == 0) { return 0; }
+    record(buffer, n);
+    return n;
+}
+
+void RecordingSource::asyncRead(uint8_t* buffer, size_t length,
+                                const ReadHandler& handler)
+{
+    // record() does not throw: an exception here would end up in the
+    // reactor and the handler would never run
+    m_source->asyncRead(buffer, length,
+        [this, buffer, handler](const boost::system::error_code& ec,
+                                size_t n)
+        {
+            if (!ec && n > 0) { record(buffer, n); }
+            handler(ec, n);
+        });
+}
+
+void RecordingSource::write(const uint8_t* data, size_t length)
+{
+    m_source->write(data, length);
+}
+
+void RecordingSource::record(const uint8_t* buffer, size_t length)
+{
+    if (m_file == NULL) { return; }
+    uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_start).count();
+    uint8_t header[CaptureRecordHeaderLength];
+    putLE(header, time, 8);
+    putLE(header + 8, length, 4);
+    try
+    {
+        append(header, sizeof(header));
+        append(buffer, length);
+    }
+    catch (const std::exception& e)
+    {
+        // A full disk ends the capture, not the acquisition
+        std::cerr << "RecordingSource: recording stopped: " << e.what()
+                  << std::endl;
+        fclose(m_file);
+        m_file = NULL;
+    }
+}
+
+void RecordingSource::append(const void* data, size_t length)
+{
+    // stdio buffers the small records, one write(2) per few kilobytes
+    if (fwrite(data, 1, length, m_file) != length)
+    {
+        throw fileError("cannot write", m_path);
+    }
+}
+
+#if !defined(_WIN32)
+ReplaySource::ReplaySource(const std::string& path, double speed)
+  : m_data(NULL), m_size(0), m_baudRate(0), m_speed(speed),
+    m_offset(CaptureHeaderLength), m_remaining(0),
+    m_started(false), m_firstTime(0), m_cancelled(false)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { throw fileError("cannot open", path); }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw fileError("cannot stat", path);
+    }
+    if (size_t(st.st_size) < CaptureHeaderLength)
+    {
+        ::close(fd);
+        throw std::runtime_error("not an LDS capture file: " + path);
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) { throw fileError("cannot map", path); }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = st.st_size;
+
+    if (memcmp(m_data, CaptureMagic, sizeof(CaptureMagic)) != 0)
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+        throw std::runtime_error("not an LDS capture file: " + path);
+    }
+    m_baudRate = uint32_t(getLE(m_data + 8, 4));
+}
+
+ReplaySource::~ReplaySource()
+{
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+}
+#else
+ReplaySource::ReplaySource(const std::string& path, double speed)
+  : m_data(NULL), m_size(0), m_baudRate(0), m_speed(speed),
+    m_offset(0), m_remaining(0), m_started(false), m_firstTime(0),
+    m_cancelled(false)
+{
+    throw std::runtime_error("capture replay is not supported on Windows");
+}
+
+ReplaySource::~ReplaySource()
+{
+}
+#endif
+
+size_t ReplaySource::read(uint8_t* buffer, size_t length)
+{
+    {
+        // A cancel() between two reads ends the next one right away
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_cancelled) { return 0; }
+    }
+    while (m_remaining == 0)
+    {
+        // A truncated last record ends the stream
+        if (m_size - m_offset < CaptureRecordHeaderLength) { return 0; }
+        uint64_t time = getLE(m_data + m_offset, 8);
+        size_t size = size_t(getLE(m_data + m_offset + 8, 4));
+        m_offset += CaptureRecordHeaderLength;
+        if (m_size - m_offset < size)
+        {
+            m_offset = m_size;
+            return 0;
+        }
+        m_remaining = size;
+        if (!pace(time)) { return 0; }
+    }
+
+    size_t n = std::min(length, m_remaining);
+    memcpy(buffer, m_data + m_offset, n);
+    m_offset += n;
+    m_remaining -= n;
+    return n;
+}
+
+void ReplaySource::write(const uint8_t*, size_t)
+{
+}
+
+void ReplaySource::cancel()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cancelled = true;
+    m_wake.notify_all();
+}
+
+bool ReplaySource::pace(uint64_t time)
+{
+    if (m_speed <= 0.0) { return true; }
+    if (!m_started)
+    {
+        m_started = true;
+        m_firstTime = time;
+        m_start = std::chrono::steady_clock::now();
+    }
+    std::chrono::nanoseconds due(int64_t((time - m_firstTime) / m_speed));
+    std::unique_lock<std::mutex> lock(m_mutex);
+    // The record stays pending for the next read when cancelled
+    return !m_wake.wait_until(lock, m_start + due,
+                              [this] { return m_cancelled; });
+}
+
+}
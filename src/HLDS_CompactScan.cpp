@@ -0,0 +1,241 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_CompactScan.cpp
+ * @brief Fixed point and delta coding of the CompactScan data type
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_CompactScan.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+
+inline uint8_t* putVarint(uint8_t* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = uint8_t(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = uint8_t(value);
+    return out;
+}
+
+// NULL if the varint runs past end or exceeds 16 bits
+inline const uint8_t* getVarint(const uint8_t* in, const uint8_t* end,
+                                uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 21 && in < end; shift += 7)
+    {
+        uint8_t byte = *in++;
+        value |= uint32_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) { return value <= 0xFFFF ? in : NULL; }
+    }
+    return NULL;
+}
+
+inline uint16_t previousValue(const uint16_t* previous, size_t i)
+{
+    return previous != NULL ? previous[i] : 0;
+}
+
+}
+
+void quantiseRanges(const double* ranges, size_t count, uint16_t* mm)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        double value = ranges[i] * 1000.0 + 0.5;
+        mm[i] = !(value >= 1.0) ? 0 :
+                value >= 65535.0 ? 65535 : uint16_t(value);
+    }
+}
+
+void quantiseIntensities(const double* intensities, size_t count,
+                         uint16_t* values)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        double value = intensities[i] + 0.5;
+        values[i] = !(value >= 1.0) ? 0 :
+                    value >= 65535.0 ? 65535 : uint16_t(value);
+    }
+}
+
+size_t deltaEncode(const uint16_t* values, const uint16_t* previous,
+                   size_t count, uint8_t* out)
+{
+    uint8_t* p = out;
+    size_t i = 0;
+    while (i < count)
+    {
+        int16_t delta = int16_t(uint16_t(values[i] -
+                                         previousValue(previous, i)));
+        if (delta == 0)
+        {
+            size_t run = 1;
+            while (i + run < count &&
+                   values[i + run] == previousValue(previous, i + run))
+            {
+                ++run;
+            }
+            *p++ = 0;
+            p = putVarint(p, uint32_t(run - 1));
+            i += run;
+            continue;
+        }
+        // Zigzag: small differences of either sign take one byte
+        uint16_t zigzag = uint16_t((uint16_t(delta) << 1) ^ (delta >> 15));
+        p = putVarint(p, zigzag);
+        ++i;
+    }
+    return size_t(p - out);
+}
+
+size_t deltaDecode(const uint8_t* data, size_t length,
+                   const uint16_t* previous, size_t count, uint16_t* values)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + length;
+    size_t i = 0;
+    while (i < count)
+    {
+        uint32_t token;
+        if ((p = getVarint(p, end, token)) == NULL) { return 0; }
+        if (token == 0)
+        {
+            uint32_t extra;
+            if ((p = getVarint(p, end, extra)) == NULL) { return 0; }
+            if (extra >= count - i) { return 0; }
+            for (size_t k = 0; k <= extra; ++k, ++i)
+            {
+                values[i] = previousValue(previous, i);
+            }
+            continue;
+        }
+        uint16_t delta = uint16_t((token >> 1) ^ (0u - (token & 1)));
+        values[i] = uint16_t(previousValue(previous, i) + delta);
+        ++i;
+    }
+    return size_t(p - data);
+}
+
+CompactEncoder::CompactEncoder()
+  : m_hasIntensities(false), m_seq(0), m_interval(10), m_countdown(0)
+{
+    memset(m_ranges, 0, sizeof(m_ranges));
+    memset(m_intensities, 0, sizeof(m_intensities));
+}
+
+void CompactEncoder::setKeyFrameInterval(size_t interval)
+{
+    m_interval = interval > 0 ? interval : 1;
+    if (m_countdown >= m_interval) { m_countdown = 0; }
+}
+
+void CompactEncoder::reset()
+{
+    m_countdown = 0;
+}
+
+size_t CompactEncoder::encode(const uint16_t* ranges,
+                              const uint16_t* intensities, uint8_t* out,
+                              uint32_t& seq, uint32_t& reference)
+{
+    const bool has_intensities = intensities != NULL;
+    const bool key = m_countdown == 0 || has_intensities != m_hasIntensities;
+    reference = key ? m_seq + 1 : m_seq;
+    seq = ++m_seq;
+    m_countdown = key ? m_interval - 1 : m_countdown - 1;
+
+    size_t length = deltaEncode(ranges, key ? NULL : m_ranges,
+                                CompactScanBeams, out);
+    memcpy(m_ranges, ranges, sizeof(m_ranges));
+    if (has_intensities)
+    {
+        length += deltaEncode(intensities, key ? NULL : m_intensities,
+                              CompactScanBeams, out + length);
+        memcpy(m_intensities, intensities, sizeof(m_intensities));
+    }
+    m_hasIntensities = has_intensities;
+    return length;
+}
+
+uint32_t CompactEncoder::rawFrame()
+{
+    m_countdown = 0;
+    return ++m_seq;
+}
+
+CompactDecoder::CompactDecoder()
+  : m_valid(false), m_seq(0)
+{
+    memset(m_ranges, 0, sizeof(m_ranges));
+    memset(m_intensities, 0, sizeof(m_intensities));
+}
+
+bool CompactDecoder::decode(uint32_t seq, uint32_t reference,
+                            const uint8_t* data, size_t length,
+                            bool has_intensities, uint16_t* ranges,
+                            uint16_t* intensities)
+{
+    const bool key = reference == seq;
+    if (!key && !(m_valid && reference == m_seq))
+    {
+        m_valid = false;
+        return false;
+    }
+    size_t used = deltaDecode(data, length, key ? NULL : m_ranges,
+                              CompactScanBeams, ranges);
+    if (used != 0 && has_intensities)
+    {
+        size_t more = deltaDecode(data + used, length - used,
+                                  key ? NULL : m_intensities,
+                                  CompactScanBeams, intensities);
+        used = more != 0 ? used + more : 0;
+    }
+    m_valid = used == length;
+    if (!m_valid) { return false; }
+    memcpy(m_ranges, ranges, sizeof(m_ranges));
+    if (has_intensities)
+    {
+        memcpy(m_intensities, intensities, sizeof(m_intensities));
+    }
+    m_seq = seq;
+    return true;
+}
+
+}
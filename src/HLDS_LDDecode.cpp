@@ -0,0 +1,438 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDDecode.cpp
+ * @brief Decoding of LDS frames into caller supplied buffers
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_LDDecode.h>
+#include "HLDS_LDDecodeKernels.h"
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(HLDS_DECODE_NEON) && defined(__linux__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+
+namespace HLDS
+{
+
+bool validateHeader(const uint8_t* packet, uint16_t n)
+{
+    return packet[0] == 0xFA && packet[1] == 0xA0 + n;
+}
+
+void writeChecksum(uint8_t* packet)
+{
+    uint16_t chk = kernels::checksumScalar(packet);
+    packet[PacketLength - 2] = uint8_t(chk);
+    packet[PacketLength - 1] = uint8_t(chk >> 8);
+}
+
+size_t rotationShift(double offset, double increment)
+{
+    // offset[rad]/angular_resolution[rad/index] => index_offset
+    int shift = int(offset / increment) % int(BeamCount);
+    return shift < 0 ? shift + BeamCount : shift;
+}
+
+ScanTiming scanTiming(const RawFrame& frame)
+{
+    // PacketCount - 1 packet periods between the first and last arrival,
+    // as bursty as the serial port delivers them
+    double period = frame.period != 0 ? double(frame.period) / BeamCount :
+        double(frame.completeTime - frame.firstPacketTime) /
+        (PacketCount - 1) / BeamsPerPacket;
+    uint64_t lead = uint64_t(period * (BeamsPerPacket - 1));
+    ScanTiming timing;
+    timing.start = frame.firstPacketTime - lead;
+    timing.wallStart = frame.firstPacketWallTime - lead;
+    timing.beamPeriod = period * 1e-9;
+    return timing;
+}
+
+void beamTimes(const ScanTiming& timing, double* out, size_t shift)
+{
+    // Beam j in measurement order is beam 359 - j
+    size_t pos = (BeamCount - 1 + shift) % BeamCount;
+    for (uint16_t j = 0; j < BeamCount; ++j)
+    {
+        out[pos] = j * timing.beamPeriod;
+        pos = (pos == 0) ? BeamCount - 1 : pos - 1;
+    }
+}
+
+RotationPlan makeRotationPlan(double offset, double increment, double scale)
+{
+    RotationPlan plan;
+    plan.scale = scale;
+    plan.shift = rotationShift(offset, increment);
+    plan.spans[0].from = 0;
+    plan.spans[0].to = plan.shift;
+    plan.spans[0].length = BeamCount - plan.shift;
+    plan.spans[1].from = BeamCount - plan.shift;
+    plan.spans[1].to = 0;
+    plan.spans[1].length = plan.shift;
+    return plan;
+}
+
+template <typename T>
+void decodeFrameScalar(const RawFrame& frame, const ScanSpan<T>& out)
+{
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        // The sensor scans clockwise: sample k of packet n is
+        // beam 359 - (6n + k). One modulo per packet, the position
+        // then walks down and wraps explicitly.
+        kernels::decodePacket(frame.bytes + n * PacketLength + 4,
+                              (frame.valid >> n) & 1,
+                              kernels::packetPosition(n, out.shift), out);
+    }
+}
+
+template <typename T>
+void decodeSector(const Sector& sector, T* ranges, T* intensities,
+                  double scale)
+{
+    // Sample k is beam 359 - (6n + k): the last sample comes first
+    ScanSpan<T> out = { ranges, intensities, scale, 0 };
+    kernels::decodePacket(sector.bytes + 4, true, BeamsPerPacket - 1, out);
+}
+
+#if defined(__SSE2__)
+namespace kernels
+{
+
+static inline uint16_t load16(const uint8_t* p)
+{
+    return uint16_t(p[0] | (p[1] << 8));
+}
+
+// Store six doubles given as three pairs
+static inline void store6(double* dst, __m128d a, __m128d b, __m128d c)
+{
+    _mm_storeu_pd(dst, a);
+    _mm_storeu_pd(dst + 2, b);
+    _mm_storeu_pd(dst + 4, c);
+}
+
+static inline void store6(float* dst, __m128d a, __m128d b, __m128d c)
+{
+    _mm_storeu_ps(dst, _mm_movelh_ps(_mm_cvtpd_ps(a), _mm_cvtpd_ps(b)));
+    _mm_storel_pi(reinterpret_cast<__m64*>(dst + 4), _mm_cvtpd_ps(c));
+}
+
+/*
+ * SSE2 has no byte shuffle, the six words of a packet are gathered with
+ * pinsrw and the conversion, division and scaling run two lanes wide.
+ */
+template <typename T>
+void decodeSSE2(const RawFrame& frame, const ScanSpan<T>& out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128d thousand = _mm_set1_pd(1000.0);
+    const __m128d scale = _mm_set1_pd(out.scale);
+
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        const uint8_t* s = frame.bytes + n * PacketLength + 4;
+        bool valid = (frame.valid >> n) & 1;
+        size_t pos = packetPosition(n, out.shift);
+        if (!valid || pos < BeamsPerPacket - 1)
+        {
+            decodePacket(s, valid, pos, out);
+            continue;
+        }
+        // Samples k = 5..0 in ascending output order
+        size_t first = pos - (BeamsPerPacket - 1);
+        __m128i r = _mm_setr_epi16(load16(s + 32), load16(s + 26),
+                                   load16(s + 20), load16(s + 14),
+                                   load16(s + 8), load16(s + 2), 0, 0);
+        __m128i lo = _mm_unpacklo_epi16(r, zero);
+        __m128i hi = _mm_unpackhi_epi16(r, zero);
+        __m128d r0 = _mm_cvtepi32_pd(lo);
+        __m128d r1 = _mm_cvtepi32_pd(_mm_srli_si128(lo, 8));
+        __m128d r2 = _mm_cvtepi32_pd(hi);
+        store6(out.ranges + first,
+               _mm_mul_pd(_mm_div_pd(r0, thousand), scale),
+               _mm_mul_pd(_mm_div_pd(r1, thousand), scale),
+               _mm_mul_pd(_mm_div_pd(r2, thousand), scale));
+
+        if (out.intensities != NULL)
+        {
+            __m128i i = _mm_setr_epi16(load16(s + 30), load16(s + 24),
+                                       load16(s + 18), load16(s + 12),
+                                       load16(s + 6), load16(s), 0, 0);
+            lo = _mm_unpacklo_epi16(i, zero);
+            hi = _mm_unpackhi_epi16(i, zero);
+            store6(out.intensities + first,
+                   _mm_cvtepi32_pd(lo),
+                   _mm_cvtepi32_pd(_mm_srli_si128(lo, 8)),
+                   _mm_cvtepi32_pd(hi));
+        }
+    }
+}
+
+}
+#endif
+
+namespace
+{
+
+template <typename T>
+struct Kernel
+{
+    typedef void (*Function)(const RawFrame&, const ScanSpan<T>&);
+};
+
+uint16_t sentChecksum(const uint8_t* packet)
+{
+    return uint16_t(packet[PacketLength - 2] |
+                    (packet[PacketLength - 1] << 8));
+}
+
+template <typename T>
+bool sameResults(typename Kernel<T>::Function kernel, const RawFrame& frame,
+                 size_t shift, double scale)
+{
+    T expected[2][BeamCount];
+    T actual[2][BeamCount];
+    ScanSpan<T> e = { expected[0], expected[1], scale, shift };
+    ScanSpan<T> a = { actual[0], actual[1], scale, shift };
+    decodeFrameScalar(frame, e);
+    kernel(frame, a);
+    return memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+#if defined(HLDS_DECODE_NEON)
+bool neonSupported()
+{
+#if defined(__aarch64__)
+    return true;
+#elif defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#else
+    return false;
+#endif
+}
+#endif
+
+}
+
+namespace kernels
+{
+
+/*
+ * Bit exact equivalence check of a kernel against the scalar decoder
+ * and checksum, run once before a kernel is selected. Covers invalid
+ * packets, the wrapping packet at every alignment and non trivial scale
+ * factors.
+ */
+bool verify(const KernelSet& kernel)
+{
+    RawFrame frame;
+    uint32_t seed = 0x2545F491;
+    for (uint16_t i = 0; i < FrameLength; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        frame.bytes[i] = uint8_t(seed >> 24);
+    }
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        uint8_t* packet = frame.bytes + n * PacketLength;
+        if (kernel.checksum(packet) != checksumScalar(packet))
+        {
+            return false;
+        }
+        packet[0] = 0xFA;
+        packet[1] = 0xA0 + n;
+        writeChecksum(packet);
+    }
+    frame.bytes[7 * PacketLength + 1] = 0x00;
+    frame.bytes[9 * PacketLength + 20] ^= 0x10;
+    frame.valid = 0;
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        const uint8_t* packet = frame.bytes + n * PacketLength;
+        if (validateHeader(packet, n) &&
+            kernel.checksum(packet) == sentChecksum(packet))
+        {
+            frame.valid |= uint64_t(1) << n;
+        }
+    }
+    const uint64_t all = (uint64_t(1) << PacketCount) - 1;
+    if (frame.valid != (all & ~(uint64_t(1) << 7 | uint64_t(1) << 9)))
+    {
+        return false;
+    }
+
+    const double scales[] = { 1.0, 0.001, 3.3 };
+    for (size_t shift = 0; shift < BeamsPerPacket + 1; ++shift)
+    {
+        for (size_t i = 0; i < sizeof(scales) / sizeof(scales[0]); ++i)
+        {
+            size_t shifts[] = { shift, BeamCount / 2 + shift };
+            for (size_t j = 0; j < 2; ++j)
+            {
+                if (!sameResults<float>(kernel.decodeFloat, frame,
+                                        shifts[j], scales[i]) ||
+                    !sameResults<double>(kernel.decodeDouble, frame,
+                                         shifts[j], scales[i]))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+size_t availableKernels(KernelSet* out)
+{
+    size_t count = 0;
+    // The CPU is only queried with GCC and Clang, other compilers fall
+    // back to the SSE2 or scalar decoder
+#if defined(HLDS_DECODE_AVX2) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        KernelSet avx2 = { "AVX2", decodeAVX2<float>, decodeAVX2<double>,
+                           checksumAVX2 };
+        out[count++] = avx2;
+    }
+#endif
+#if defined(HLDS_DECODE_NEON)
+    if (neonSupported())
+    {
+        KernelSet neon = { "NEON", decodeNEON<float>, decodeNEON<double>,
+                           checksumNEON };
+        out[count++] = neon;
+    }
+#endif
+#if defined(__SSE2__)
+    // SSE2 has no per lane shift, the scalar loop is vectorized by the
+    // compiler where it pays off
+    KernelSet sse2 = { "SSE2", decodeSSE2<float>, decodeSSE2<double>,
+                       checksumScalar };
+    out[count++] = sse2;
+#endif
+    KernelSet scalar = { "scalar", decodeFrameScalar<float>,
+                         decodeFrameScalar<double>, checksumScalar };
+    out[count++] = scalar;
+    return count;
+}
+
+}
+
+namespace
+{
+
+kernels::KernelSet selectKernel()
+{
+    kernels::KernelSet available[kernels::MaxKernels];
+    size_t count = kernels::availableKernels(available);
+    for (size_t i = 0; i + 1 < count; ++i)
+    {
+        if (kernels::verify(available[i])) { return available[i]; }
+        std::cerr << "decodeFrame: the " << available[i].name
+                  << " kernel differs from the scalar decoder, not used"
+                  << std::endl;
+    }
+    return available[count - 1];
+}
+
+const kernels::KernelSet& kernel()
+{
+    static const kernels::KernelSet selected = selectKernel();
+    return selected;
+}
+
+Kernel<float>::Function function(const kernels::KernelSet& kernel, float*)
+{
+    return kernel.decodeFloat;
+}
+
+Kernel<double>::Function function(const kernels::KernelSet& kernel, double*)
+{
+    return kernel.decodeDouble;
+}
+
+}
+
+const char* decodeKernel()
+{
+    return kernel().name;
+}
+
+uint16_t packetChecksum(const uint8_t* packet)
+{
+    return kernel().checksum(packet);
+}
+
+bool validatePacket(const uint8_t* packet, uint16_t n)
+{
+    return validateHeader(packet, n) &&
+           packetChecksum(packet) == sentChecksum(packet);
+}
+
+uint64_t validatePackets(const uint8_t* frame)
+{
+    uint64_t valid = 0;
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        if (validatePacket(frame + n * PacketLength, n))
+        {
+            valid |= uint64_t(1) << n;
+        }
+    }
+    return valid;
+}
+
+template <typename T>
+void decodeFrame(const RawFrame& frame, const ScanSpan<T>& out)
+{
+    function(kernel(), static_cast<T*>(NULL))(frame, out);
+}
+
+template void decodeFrame<float>(const RawFrame&, const ScanSpan<float>&);
+template void decodeFrame<double>(const RawFrame&, const ScanSpan<double>&);
+template void decodeSector<float>(const Sector&, float*, float*, double);
+template void decodeSector<double>(const Sector&, double*, double*, double);
+
+template void decodeFrameScalar<float>(const RawFrame&,
+                                       const ScanSpan<float>&);
+template void decodeFrameScalar<double>(const RawFrame&,
+                                        const ScanSpan<double>&);
+
+}
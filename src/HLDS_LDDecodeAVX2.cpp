@@ -0,0 +1,156 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDDecodeAVX2.cpp
+ * @brief AVX2 LDS frame decoding kernel
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HLDS_LDDecodeKernels.h"
+
+// This file is compiled with AVX2 code generation enabled and only
+// called after a CPUID check, keep it free of shared inline code.
+#if defined(HLDS_DECODE_AVX2)
+#include <immintrin.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+namespace
+{
+/*
+ * The 36 data bytes of a packet hold six samples of 6 bytes:
+ * intensity (u16), range (u16) and 2 reserved bytes. Two overlapping
+ * 16 byte loads at offsets 0 and 18 see samples 0-2 and 3-5 at the same
+ * byte positions, so one pair of byte shuffles gathers the six words in
+ * reverse order (samples 5..0), which is ascending output order.
+ */
+const int8_t Z = -1;
+
+inline __m128i gather(__m128i a, __m128i b, int word)
+{
+    const int8_t w = int8_t(word);
+    const __m128i from_b = _mm_setr_epi8(w + 12, w + 13, w + 6, w + 7,
+                                         w, w + 1, Z, Z, Z, Z, Z, Z,
+                                         Z, Z, Z, Z);
+    const __m128i from_a = _mm_setr_epi8(Z, Z, Z, Z, Z, Z,
+                                         w + 12, w + 13, w + 6, w + 7,
+                                         w, w + 1, Z, Z, Z, Z);
+    return _mm_or_si128(_mm_shuffle_epi8(b, from_b),
+                        _mm_shuffle_epi8(a, from_a));
+}
+
+inline void store6(double* dst, __m256d lo, __m128d hi)
+{
+    _mm256_storeu_pd(dst, lo);
+    _mm_storeu_pd(dst + 4, hi);
+}
+
+inline void store6(float* dst, __m256d lo, __m128d hi)
+{
+    _mm_storeu_ps(dst, _mm256_cvtpd_ps(lo));
+    _mm_storel_pi(reinterpret_cast<__m64*>(dst + 4), _mm_cvtpd_ps(hi));
+}
+}
+
+template <typename T>
+void decodeAVX2(const RawFrame& frame, const ScanSpan<T>& out)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m256d thousand4 = _mm256_set1_pd(1000.0);
+    const __m256d scale4 = _mm256_set1_pd(out.scale);
+    const __m128d thousand2 = _mm_set1_pd(1000.0);
+    const __m128d scale2 = _mm_set1_pd(out.scale);
+
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        const uint8_t* s = frame.bytes + n * PacketLength + 4;
+        bool valid = (frame.valid >> n) & 1;
+        size_t pos = packetPosition(n, out.shift);
+        if (!valid || pos < BeamsPerPacket - 1)
+        {
+            decodePacket(s, valid, pos, out);
+            continue;
+        }
+        size_t first = pos - (BeamsPerPacket - 1);
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 18));
+
+        __m128i r = gather(a, b, 2);
+        __m256d r_lo = _mm256_cvtepi32_pd(_mm_unpacklo_epi16(r, zero));
+        __m128d r_hi = _mm_cvtepi32_pd(_mm_unpackhi_epi16(r, zero));
+        store6(out.ranges + first,
+               _mm256_mul_pd(_mm256_div_pd(r_lo, thousand4), scale4),
+               _mm_mul_pd(_mm_div_pd(r_hi, thousand2), scale2));
+
+        if (out.intensities != NULL)
+        {
+            __m128i i = gather(a, b, 0);
+            store6(out.intensities + first,
+                   _mm256_cvtepi32_pd(_mm_unpacklo_epi16(i, zero)),
+                   _mm_cvtepi32_pd(_mm_unpackhi_epi16(i, zero)));
+        }
+    }
+}
+
+template void decodeAVX2<float>(const RawFrame&, const ScanSpan<float>&);
+template void decodeAVX2<double>(const RawFrame&, const ScanSpan<double>&);
+
+/*
+ * The 20 checksum words are zero extended to 32 bits (8 + 8 + 4 lanes)
+ * and every lane is shifted by its own count with vpsllvd.
+ */
+uint16_t checksumAVX2(const uint8_t* packet)
+{
+    const __m256i shift0 = _mm256_setr_epi32(19, 18, 17, 16, 15, 14, 13, 12);
+    const __m256i shift1 = _mm256_setr_epi32(11, 10, 9, 8, 7, 6, 5, 4);
+    const __m128i shift2 = _mm_setr_epi32(3, 2, 1, 0);
+
+    const __m128i* p = reinterpret_cast<const __m128i*>(packet);
+    __m256i w0 = _mm256_cvtepu16_epi32(_mm_loadu_si128(p));
+    __m256i w1 = _mm256_cvtepu16_epi32(_mm_loadu_si128(p + 1));
+    __m128i w2 = _mm_cvtepu16_epi32(_mm_loadl_epi64(p + 2));
+
+    __m256i sum = _mm256_add_epi32(_mm256_sllv_epi32(w0, shift0),
+                                   _mm256_sllv_epi32(w1, shift1));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                              _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_sllv_epi32(w2, shift2));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return foldChecksum(uint32_t(_mm_cvtsi128_si32(s)));
+}
+
+}
+}
+
+#endif // HLDS_DECODE_AVX2
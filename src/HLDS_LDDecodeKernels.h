@@ -0,0 +1,168 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDDecodeKernels.h
+ * @brief Architecture specific LDS frame decoding kernels
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_LDDECODEKERNELS_H
+#define HLDS_LDDECODEKERNELS_H
+
+#include <HLDS_LDDecode.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+/*
+ * Every kernel has the signature and exact results of
+ * decodeFrameScalar() or checksumScalar(). The vector kernels decode the six samples of a
+ * packet at once and fall back to decodePacket() for invalid packets and
+ * for the packet whose beams wrap around the end of the output buffer.
+ *
+ * Helpers here have internal linkage on purpose: the kernels are built
+ * with different instruction set flags and must not share code.
+ */
+
+/**
+* @brief Output position of the first sample of packet n
+* The remaining samples of the packet go to the positions below.
+*/
+static inline size_t packetPosition(uint16_t n, size_t shift)
+{
+    return (BeamCount - 1 - BeamsPerPacket * n + shift) % BeamCount;
+}
+
+/**
+* @brief Scalar decoding of one packet
+* @param sample First sample of the packet (packet + 4)
+*/
+template <typename T>
+static inline void decodePacket(const uint8_t* sample, bool valid,
+                                size_t pos, const ScanSpan<T>& out)
+{
+    for (uint16_t k = 0; k < BeamsPerPacket; ++k, sample += 6)
+    {
+        if (valid)
+        {
+            uint16_t intensity = (sample[1] << 8) + sample[0];
+            uint16_t range = (sample[3] << 8) + sample[2];
+            out.ranges[pos] = T(range / 1000.0 * out.scale);
+            if (out.intensities != NULL)
+            {
+                out.intensities[pos] = T(intensity);
+            }
+        }
+        else
+        {
+            out.ranges[pos] = T(0);
+            if (out.intensities != NULL) { out.intensities[pos] = T(0); }
+        }
+        pos = (pos == 0) ? BeamCount - 1 : pos - 1;
+    }
+}
+
+// Number of 16 bit words covered by the packet checksum
+const uint16_t ChecksumWords = 20;
+
+/**
+* @brief Fold the 32 bit checksum accumulator to 15 bits
+*/
+static inline uint16_t foldChecksum(uint32_t chk32)
+{
+    return uint16_t(((chk32 & 0x7FFF) + (chk32 >> 15)) & 0x7FFF);
+}
+
+/**
+* @brief Scalar packet checksum
+* The sequential chk = (chk << 1) + word is written as a sum of
+* independent terms word[i] << (19 - i), which compilers vectorize.
+*/
+static inline uint16_t checksumScalar(const uint8_t* packet)
+{
+    uint32_t chk32 = 0;
+    for (uint16_t i = 0; i < ChecksumWords; ++i)
+    {
+        uint32_t word = packet[2 * i] | (packet[2 * i + 1] << 8);
+        chk32 += word << (ChecksumWords - 1 - i);
+    }
+    return foldChecksum(chk32);
+}
+
+/**
+* @brief A decoder and checksum kernel pair
+*/
+struct KernelSet
+{
+    const char* name;
+    void (*decodeFloat)(const RawFrame&, const ScanSpan<float>&);
+    void (*decodeDouble)(const RawFrame&, const ScanSpan<double>&);
+    uint16_t (*checksum)(const uint8_t*);
+};
+
+// Number of kernel sets that can be compiled in
+const size_t MaxKernels = 4;
+
+/**
+* @brief Kernel sets compiled in and supported by this CPU
+* Fastest first, the scalar set is always the last one.
+* @param out MaxKernels entries
+* @return Number of kernel sets written to out
+*/
+size_t availableKernels(KernelSet* out);
+
+/**
+* @brief Bit exact check of a kernel set against the scalar code
+* Run by decodeFrame() on first use, a kernel set failing it is skipped
+* and reported on std::cerr.
+*/
+bool verify(const KernelSet& kernel);
+
+#if defined(__SSE2__)
+template <typename T>
+void decodeSSE2(const RawFrame& frame, const ScanSpan<T>& out);
+#endif
+#if defined(HLDS_DECODE_AVX2)
+template <typename T>
+void decodeAVX2(const RawFrame& frame, const ScanSpan<T>& out);
+uint16_t checksumAVX2(const uint8_t* packet);
+#endif
+#if defined(HLDS_DECODE_NEON)
+template <typename T>
+void decodeNEON(const RawFrame& frame, const ScanSpan<T>& out);
+uint16_t checksumNEON(const uint8_t* packet);
+#endif
+
+}
+}
+
+#endif // HLDS_LDDECODEKERNELS_H
@@ -0,0 +1,165 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDDecodeNEON.cpp
+ * @brief NEON LDS frame decoding kernel
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HLDS_LDDecodeKernels.h"
+
+// This file is compiled with NEON code generation enabled (-mfpu=neon on
+// 32-bit ARM) and only called after a HWCAP check, keep it free of
+// shared inline code.
+#if defined(HLDS_DECODE_NEON)
+#include <arm_neon.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+namespace
+{
+/*
+ * Store six words given as lanes [5 4 3 2] and [1 0], converted to T and
+ * optionally divided by 1000 and scaled, in the same operation order as
+ * the scalar decoder. ARMv7 NEON has no double precision lanes, so the
+ * arithmetic stays on VFP there.
+ */
+template <typename T>
+inline void store6(T* dst, uint32x4_t lo, uint32x2_t hi,
+                   bool to_metre, double scale)
+{
+#if defined(__aarch64__)
+    float64x2_t v[3];
+    v[0] = vcvtq_f64_u64(vmovl_u32(vget_low_u32(lo)));
+    v[1] = vcvtq_f64_u64(vmovl_u32(vget_high_u32(lo)));
+    v[2] = vcvtq_f64_u64(vmovl_u32(hi));
+    if (to_metre)
+    {
+        const float64x2_t thousand = vdupq_n_f64(1000.0);
+        const float64x2_t factor = vdupq_n_f64(scale);
+        for (int i = 0; i < 3; ++i)
+        {
+            v[i] = vmulq_f64(vdivq_f64(v[i], thousand), factor);
+        }
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        if (sizeof(T) == sizeof(double))
+        {
+            vst1q_f64(reinterpret_cast<double*>(dst) + 2 * i, v[i]);
+        }
+        else
+        {
+            vst1_f32(reinterpret_cast<float*>(dst) + 2 * i,
+                     vcvt_f32_f64(v[i]));
+        }
+    }
+#else
+    uint32_t words[6];
+    vst1q_u32(words, lo);
+    vst1_u32(words + 4, hi);
+    for (int i = 0; i < 6; ++i)
+    {
+        dst[i] = to_metre ? T(words[i] / 1000.0 * scale) : T(words[i]);
+    }
+#endif
+}
+}
+
+template <typename T>
+void decodeNEON(const RawFrame& frame, const ScanSpan<T>& out)
+{
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        const uint8_t* s = frame.bytes + n * PacketLength + 4;
+        bool valid = (frame.valid >> n) & 1;
+        size_t pos = packetPosition(n, out.shift);
+        if (!valid || pos < BeamsPerPacket - 1)
+        {
+            decodePacket(s, valid, pos, out);
+            continue;
+        }
+        size_t first = pos - (BeamsPerPacket - 1);
+        // A sample is three little endian words: intensity, range and
+        // reserved. vld3 deinterleaves samples 0-3 and 2-5.
+        uint16x4x3_t a = vld3_u16(reinterpret_cast<const uint16_t*>(s));
+        uint16x4x3_t b = vld3_u16(reinterpret_cast<const uint16_t*>(s + 12));
+
+        // Reverse to ascending output order: [5 4 3 2] and [1 0]
+        uint32x4_t r_lo = vmovl_u16(vrev64_u16(b.val[1]));
+        uint32x2_t r_hi = vget_high_u32(vmovl_u16(vrev64_u16(a.val[1])));
+        store6(out.ranges + first, r_lo, r_hi, true, out.scale);
+
+        if (out.intensities != NULL)
+        {
+            uint32x4_t i_lo = vmovl_u16(vrev64_u16(b.val[0]));
+            uint32x2_t i_hi = vget_high_u32(vmovl_u16(vrev64_u16(a.val[0])));
+            store6(out.intensities + first, i_lo, i_hi, false, 1.0);
+        }
+    }
+}
+
+template void decodeNEON<float>(const RawFrame&, const ScanSpan<float>&);
+template void decodeNEON<double>(const RawFrame&, const ScanSpan<double>&);
+
+/*
+ * The 20 checksum words are widened to 32 bits in five quads and
+ * shifted with a per lane count by vshl.
+ */
+uint16_t checksumNEON(const uint8_t* packet)
+{
+    static const int32_t shifts[ChecksumWords] = {
+        19, 18, 17, 16, 15, 14, 13, 12, 11, 10,
+        9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+    };
+    uint16x8_t w0 = vreinterpretq_u16_u8(vld1q_u8(packet));
+    uint16x8_t w1 = vreinterpretq_u16_u8(vld1q_u8(packet + 16));
+    uint16x4_t w2 = vreinterpret_u16_u8(vld1_u8(packet + 32));
+
+    uint32x4_t sum = vshlq_u32(vmovl_u16(vget_low_u16(w0)),
+                               vld1q_s32(shifts));
+    sum = vaddq_u32(sum, vshlq_u32(vmovl_u16(vget_high_u16(w0)),
+                                   vld1q_s32(shifts + 4)));
+    sum = vaddq_u32(sum, vshlq_u32(vmovl_u16(vget_low_u16(w1)),
+                                   vld1q_s32(shifts + 8)));
+    sum = vaddq_u32(sum, vshlq_u32(vmovl_u16(vget_high_u16(w1)),
+                                   vld1q_s32(shifts + 12)));
+    sum = vaddq_u32(sum, vshlq_u32(vmovl_u16(w2), vld1q_s32(shifts + 16)));
+    uint32x2_t half = vadd_u32(vget_low_u32(sum), vget_high_u32(sum));
+    return foldChecksum(vget_lane_u32(vpadd_u32(half, half), 0));
+}
+
+}
+}
+
+#endif // HLDS_DECODE_NEON
@@ -0,0 +1,193 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_LDFramer.cpp
+ * @brief Ring buffer framer for the LDS serial byte stream
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_LDFramer.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+// Relaxed increment of a counter that has a single writer
+inline void bump(std::atomic<uint64_t>& counter, uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+}
+}
+
+LDFramer::LDFramer()
+  : m_head(0), m_tail(0), m_locked(false), m_lost(false), m_last(-1),
+    m_reads(0), m_bytes(0), m_packets(0), m_frames(0), m_discarded(0),
+    m_resyncs(0)
+{
+}
+
+size_t LDFramer::writeSpace() const
+{
+    size_t free_space = Capacity - (m_tail - m_head);
+    size_t to_end = Capacity - (m_tail & Mask);
+    return free_space < to_end ? free_space : to_end;
+}
+
+void LDFramer::commit(size_t length)
+{
+    m_tail += length;
+    bump(m_reads, 1);
+    bump(m_bytes, length);
+}
+
+int LDFramer::headerAt(size_t offset) const
+{
+    if (at(offset) != 0xFA) { return -1; }
+    int index = at(offset + 1) - 0xA0;
+    return index >= 0 && index < PacketCount ? index : -1;
+}
+
+void LDFramer::discard(size_t length)
+{
+    m_head += length;
+    bump(m_discarded, length);
+}
+
+bool LDFramer::synchronize()
+{
+    // A header and the first two bytes of the packet after it
+    while (m_tail - m_head >= PacketLength + 2)
+    {
+        // Look for the first byte of the header in the contiguous
+        // part of the ring
+        size_t pos = m_head & Mask;
+        size_t length = m_tail - m_head - (PacketLength + 1);
+        if (length > Capacity - pos) { length = Capacity - pos; }
+        const uint8_t* found =
+            static_cast<const uint8_t*>(memchr(&m_ring[pos], 0xFA, length));
+        if (found == NULL)
+        {
+            discard(length);
+            continue;
+        }
+        discard(found - &m_ring[pos]);
+        if (headerAt(0) < 0 || headerAt(PacketLength) < 0)
+        {
+            discard(1);
+            continue;
+        }
+        m_locked = true;
+        if (m_lost) { bump(m_resyncs, 1); }
+        m_lost = false;
+        return true;
+    }
+    return false;
+}
+
+int LDFramer::packetIndex()
+{
+    if (m_locked && m_tail - m_head >= 2 && headerAt(0) < 0)
+    {
+        // The previous packet was cut short or overlong
+        m_locked = false;
+        m_lost = true;
+    }
+    if (!m_locked && !synchronize()) { return -1; }
+    if (m_tail - m_head < PacketLength) { return -1; }
+    if (m_tail - m_head >= PacketLength + 3 && headerAt(PacketLength) < 0)
+    {
+        // A packet a byte short or long is dropped right away when the
+        // next header is already in, rather than losing that one too
+        for (size_t offset = PacketLength - 1; offset <= PacketLength + 1;
+             offset += 2)
+        {
+            if (headerAt(offset) >= 0)
+            {
+                discard(offset);
+                bump(m_resyncs, 1);
+                return packetIndex();
+            }
+        }
+    }
+    return headerAt(0);
+}
+
+int LDFramer::nextPacket(uint8_t* frame)
+{
+    int index = packetIndex();
+    if (index < 0) { return -1; }
+
+    // Copy out the packet, it may wrap around the end of the ring
+    uint8_t* packet = frame + index * PacketLength;
+    size_t pos = m_head & Mask;
+    size_t first = Capacity - pos;
+    if (first >= PacketLength)
+    {
+        memcpy(packet, &m_ring[pos], PacketLength);
+    }
+    else
+    {
+        memcpy(packet, &m_ring[pos], first);
+        memcpy(packet + first, &m_ring[0], PacketLength - first);
+    }
+    m_head += PacketLength;
+    bump(m_packets, 1);
+
+    // A revolution ends with its last packet, or with a packet of the
+    // next one if the last packets were lost
+    if (m_last >= 0 && index <= m_last) { bump(m_frames, 1); }
+    if (index == PacketCount - 1)
+    {
+        bump(m_frames, 1);
+        m_last = -1;
+    }
+    else
+    {
+        m_last = index;
+    }
+    return index;
+}
+
+FramerStats LDFramer::stats() const
+{
+    FramerStats stats;
+    stats.reads = m_reads.load(std::memory_order_relaxed);
+    stats.bytes = m_bytes.load(std::memory_order_relaxed);
+    stats.packets = m_packets.load(std::memory_order_relaxed);
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    stats.discarded = m_discarded.load(std::memory_order_relaxed);
+    stats.resyncs = m_resyncs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}
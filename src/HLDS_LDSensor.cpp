@@ -33,113 +33,444 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <HLDS_LDSensor.h>
-#include <boost/asio.hpp>
+#include <HLDS_Reactor.h>
+#include <cstdlib>
+#include <future>
 #include <iostream>
-#include <array>
+#include <string.h>
 #include <math.h>
 
 
 namespace HLDS
 {
 
-// 
-const uint16_t BufferLength = 2520;
-
+namespace
+{
+// Counters have a single writer, the acquisition thread
+inline void bump(std::atomic<uint64_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+}
+}
 
 LDSensor::LDSensor(const std::string& port, uint32_t baud_rate)
   : m_port(port), m_baudRate(baud_rate),
-    m_shuttingDown(false), 
-    m_motorSpeed(0), m_rpms(0),
-    m_io(), m_serial(m_io, m_port)
+    m_shuttingDown(false), m_failed(false),
+    m_rpms(0),
+    m_source(openByteSource(port, baud_rate)), 
+    m_async(m_source->asynchronous()), m_reading(false),
+    m_sectorStreaming(false), m_droppedSectors(0),
+    m_scanWaiting(false), m_sectorWaiting(false),
+    m_checkChecksum(true), m_goodPackets(0), m_badChecksums(0),
+    m_readTime(0), m_received(0), m_lastPacket(-1)
+{
+    startMotor();
+}
+
+LDSensor::LDSensor(ByteSource* source)
+  : m_port(), m_baudRate(0),
+    m_shuttingDown(false), m_failed(false),
+    m_rpms(0),
+    m_source(source), 
+    m_async(m_source->asynchronous()), m_reading(false),
+    m_sectorStreaming(false), m_droppedSectors(0),
+    m_scanWaiting(false), m_sectorWaiting(false),
+    m_checkChecksum(true), m_goodPackets(0), m_badChecksums(0),
+    m_readTime(0), m_received(0), m_lastPacket(-1)
 {
-    m_serial.set_option(boost::asio::serial_port_base::baud_rate(m_baudRate));
     startMotor();
 }
 
 LDSensor::~LDSensor()
 {
+    stopAcquisition();
     stopMotor();
-    m_serial.close();
 }
 
 void LDSensor::startMotor()
 {
-    boost::asio::write(m_serial, boost::asio::buffer("b", 1));
+    m_source->write(reinterpret_cast<const uint8_t*>("b"), 1);
 }
 
 void LDSensor::stopMotor()
 {
-    boost::asio::write(m_serial, boost::asio::buffer("e", 1));
+    m_source->write(reinterpret_cast<const uint8_t*>("e"), 1);
+}
+
+bool LDSensor::readFrame(RawFrame& frame)
+{
+    while (!m_shuttingDown)
+    {
+        if (extractFrame(frame)) { return true; }
+        // Packet headers are searched in memory, read whatever
+        // the tty has available when no complete packet is buffered.
+        size_t length = readSome();
+        if (length == 0) { return false; }
+        m_readTime = monotonicNow();
+        m_framer.commit(length);
+    }
+    return false;
+}
+
+size_t LDSensor::readSome()
+{
+    if (!m_async)
+    {
+        return m_source->read(m_framer.writePtr(), m_framer.writeSpace());
+    }
+    // Read on the reactor thread, so that close() either sees the read
+    // pending and cancels it or comes first and prevents it
+    std::promise<size_t> done;
+    Reactor::instance().io().post([this, &done]()
+    {
+        if (m_shuttingDown)
+        {
+            done.set_value(0);
+            return;
+        }
+        m_source->asyncRead(m_framer.writePtr(), m_framer.writeSpace(),
+            [&done](const boost::system::error_code& ec, size_t length)
+            {
+                if (ec == boost::asio::error::operation_aborted)
+                {
+                    done.set_value(0);
+                }
+                else if (ec)
+                {
+                    done.set_exception(std::make_exception_ptr(
+                        boost::system::system_error(ec)));
+                }
+                else
+                {
+                    done.set_value(length);
+                }
+            });
+    });
+    return done.get_future().get();
+}
+
+bool LDSensor::extractFrame(RawFrame& frame)
+{
+    int n;
+    while ((n = m_framer.packetIndex()) >= 0)
+    {
+        // A packet of the next revolution ends one that lost its last
+        // packets, it stays in the framer for the next frame
+        if (m_lastPacket >= 0 && n <= m_lastPacket)
+        {
+            completeFrame(frame);
+            return true;
+        }
+        m_framer.nextPacket(frame.bytes);
+
+        // Packets are stamped with the read that completed them. After a
+        // resynchronization the revolution starts with a later packet,
+        // packet 0 was due a packet period per index earlier.
+        if (m_lastPacket < 0)
+        {
+            uint64_t lead = n * m_speed.period() / PacketCount;
+            frame.valid = 0;
+            frame.firstPacketTime = m_readTime - lead;
+            // Wall clock of the same instant, one clock read per frame
+            frame.firstPacketWallTime = wallClockNow() -
+                (monotonicNow() - m_readTime) - lead;
+            m_received = 0;
+        }
+        m_lastPacket = n;
+        m_received |= uint64_t(1) << n;
+        m_packetTimes[n] = m_readTime;
+
+        // The framer only hands out packets behind a [0xFA, 0xA0 + n]
+        // header, the checksum is left to check
+        const uint8_t* packet = frame.bytes + n * PacketLength;
+        if (m_checkChecksum && !validatePacket(packet, n))
+        {
+            bump(m_badChecksums);
+        }
+        else
+        {
+            bump(m_goodPackets);
+            frame.valid |= uint64_t(1) << n;
+            if (m_sectorCallback || m_sectorStreaming || m_sectorWaiting)
+            {
+                Sector sector;
+                sector.index = n;
+                memcpy(sector.bytes, packet, PacketLength);
+                if (m_sectorCallback) { m_sectorCallback(sector); }
+                if (m_sectorStreaming && !m_sectors.push(sector))
+                {
+                    m_droppedSectors++;
+                }
+                if (m_sectorWaiting)
+                {
+                    std::vector<SectorWaiter> waiters;
+                    {
+                        std::lock_guard<std::mutex> lock(m_waitMutex);
+                        waiters.swap(m_sectorWaiters);
+                        m_sectorWaiting = false;
+                    }
+                    for (size_t i = 0; i < waiters.size(); ++i)
+                    {
+                        *waiters[i].sector = sector;
+                        waiters[i].handler(boost::system::error_code());
+                    }
+                }
+            }
+        }
+        if (n < PacketCount - 1) { continue; }
+        completeFrame(frame);
+        return true;
+    }
+    return false;
+}
+
+void LDSensor::completeFrame(RawFrame& frame)
+{
+    // The last packet was due a packet period per missing index after
+    // the last one received
+    frame.completeTime = m_packetTimes[m_lastPacket] +
+        (PacketCount - 1 - m_lastPacket) * m_speed.period() / PacketCount;
+    m_frameLatency.record(frame.completeTime - frame.firstPacketTime);
+    if (m_received == (uint64_t(1) << PacketCount) - 1) { recordJitter(); }
+
+    frame.period = m_speed.update(frame);
+    m_rpms = uint16_t(m_speed.rpm() + 0.5);
+    m_lastPacket = -1;
+}
+
+void LDSensor::recordJitter()
+{
+    // Packets are evenly spaced over the revolution, bytes held back
+    // by the tty or the USB adapter show up as deviations from the mean
+    // interval
+    int64_t mean = int64_t(m_packetTimes[PacketCount - 1] - m_packetTimes[0]) /
+        (PacketCount - 1);
+    for (int n = 1; n < PacketCount; ++n)
+    {
+        int64_t interval = int64_t(m_packetTimes[n] - m_packetTimes[n - 1]);
+        m_packetJitter.record(uint64_t(std::abs(interval - mean)));
+    }
 }
 
 void LDSensor::poll(LaserScan& scan)
 {
-    uint8_t preamble = 0;
-    bool got_scan = false;
-    std::array<uint8_t, BufferLength> raw_bytes;
-    uint8_t good_sets = 0;
+    RawFrame frame;
+    if (!readFrame(frame)) { return; }
+    fillScan(frame, scan);
+}
 
+void LDSensor::fillScan(const RawFrame& frame, LaserScan& scan)
+{
     scan.angle_increment = (2.0 * M_PI / 360.0);
     scan.angle_min = 0.0;
     scan.angle_max = 2.0 * M_PI - scan.angle_increment;
     scan.range_min = 0.12;
     scan.range_max = 3.5;
-    scan.ranges.resize(360);
-    scan.intensities.resize(360);
+    scan.ranges.resize(BeamCount);
+    scan.intensities.resize(BeamCount);
+
+    ScanSpan<float> out = { &scan.ranges[0], &scan.intensities[0], 1.0, 0 };
+    decodeFrame(frame, out);
+    scan.time_increment = (float)scanTiming(frame).beamPeriod;
+    scan.scan_time = scan.time_increment * 360;
+}
+
+void LDSensor::startAcquisition()
+{
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    if (m_thread.joinable() || m_reading) { return; }
+    m_shuttingDown = false;
+    m_failed = false;
+    // The interval to the last revolution before a stop is no sample
+    m_speed.reset();
+    m_lastPacket = -1;
+    if (!m_async)
+    {
+        // Blocking source, e.g. a capture replay
+        m_thread = std::thread(&LDSensor::acquisitionLoop, this);
+        return;
+    }
+    m_reading = true;
+    Reactor::instance().io().post(std::bind(&LDSensor::startRead, this));
+}
 
-    while (!m_shuttingDown && !got_scan)
+void LDSensor::stopAcquisition()
+{
+    close();
+    if (m_thread.joinable()) { m_thread.join(); }
+    std::unique_lock<std::mutex> lock(m_readMutex);
+    m_readDone.wait(lock, [this] { return !m_reading; });
+}
+
+void LDSensor::close()
+{
+    m_shuttingDown = true;
+    m_source->cancel();
+    abortWaits();
+}
+
+const RawFrame* LDSensor::latestFrame()
+{
+    if (!m_frames.update()) { return NULL; }
+    return &m_frames.readBuffer();
+}
+
+void LDSensor::setSectorCallback(const SectorCallback& callback)
+{
+    m_sectorCallback = callback;
+}
+
+void LDSensor::setSectorStreaming(bool enable)
+{
+    if (enable && !m_sectorStreaming) { m_sectors.clear(); }
+    m_sectorStreaming = enable;
+}
+
+bool LDSensor::nextSector(Sector& sector)
+{
+    return m_sectors.pop(sector);
+}
+
+PacketStats LDSensor::packetStats() const
+{
+    PacketStats stats;
+    stats.good = m_goodPackets.load(std::memory_order_relaxed);
+    stats.badChecksum = m_badChecksums.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void LDSensor::startRead()
+{
+    if (!m_shuttingDown)
     {
-        // Wait until first data sync of frame: 0xFA, 0xA0
-        boost::asio::read(m_serial,
-                            boost::asio::buffer(&raw_bytes[preamble],1));
+        m_source->asyncRead(m_framer.writePtr(), m_framer.writeSpace(),
+                            std::bind(&LDSensor::onRead, this,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    m_reading = false;
+    m_readDone.notify_all();
+}
 
-        // detect the first byte of start frame
-        if (preamble == 0 && raw_bytes[preamble] == 0xFA)
+void LDSensor::onRead(const boost::system::error_code& ec, size_t length)
+{
+    bool done = m_shuttingDown || ec;
+    if (!done)
+    {
+        m_readTime = monotonicNow();
+        m_framer.commit(length);
+        try
         {
-            preamble = 1;
-            continue;
+            while (extractFrame(m_frames.writeBuffer())) { deliverFrame(); }
         }
+        catch (const std::exception& e)
+        {
+            std::cerr << "LDSensor: acquisition stopped: " << e.what() << std::endl;
+            done = true;
+            m_failed = true;
+        }
+    }
+    else if (ec && ec != boost::asio::error::operation_aborted)
+    {
+        std::cerr << "LDSensor: acquisition stopped: " << ec.message() << std::endl;
+        m_failed = true;
+    }
+    if (!done)
+    {
+        startRead();
+        return;
+    }
+    if (m_failed) { abortWaits(); }
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    m_reading = false;
+    m_readDone.notify_all();
+}
 
-        // detect the start frame (0xFA 0xA0), and reading the message body
-        if (preamble == 1 && raw_bytes[preamble] == 0xA0)
+void LDSensor::deliverFrame()
+{
+    if (m_scanWaiting)
+    {
+        std::vector<ScanWaiter> waiters;
         {
-            preamble = 0;
-            got_scan = true;
-            boost::asio::read(m_serial,
-                              boost::asio::buffer(&raw_bytes[2],
-                              BufferLength - 2));
-
-            // read data in sets of 60
-            for (uint16_t i = 0; i < raw_bytes.size(); i += 42)
-            {   // checking CRC [0xFA, 0xA0+"#/42"]
-                if (raw_bytes[i] == 0xFA && 
-                    raw_bytes[i + 1] == (0xA0 + i / 42))
-                {
-                    good_sets++;
-                    m_motorSpeed += (raw_bytes[i + 3] << 8) + raw_bytes[i + 2];
+            std::lock_guard<std::mutex> lock(m_waitMutex);
+            waiters.swap(m_scanWaiters);
+            m_scanWaiting = false;
+        }
+        for (size_t i = 0; i < waiters.size(); ++i)
+        {
+            fillScan(m_frames.writeBuffer(), *waiters[i].scan);
+            waiters[i].handler(boost::system::error_code());
+        }
+    }
+    m_frames.publish();
+}
 
-                    for (uint16_t j = i + 4; j < i + 40; j = j + 6)
-                    {
-                        int index = 6 * (i / 42) + (j - 4 - i) / 6;
-                        // intensity
-                        uint8_t byte0 = raw_bytes[j];   // intensity [1]
-                        uint8_t byte1 = raw_bytes[j+1]; // intensity [2]
-                        uint16_t intensity = (byte1 << 8) + byte0;
-                        scan.intensities[359 - index] = intensity;
-                        // range
-                        uint8_t byte2 = raw_bytes[j+2]; // range in m [1]
-                        uint8_t byte3 = raw_bytes[j+3]; // range in m [2]
-                        uint16_t range = (byte3 << 8) + byte2;    
-                        scan.ranges[359 - index] = range / 1000.0;
-                    }
-                }
-            }
-            m_rpms = m_motorSpeed / good_sets / 10;
-            scan.time_increment = (float)(1.0 / (m_rpms * 6));
-            scan.scan_time = scan.time_increment * 360;
-            continue;
+void LDSensor::waitScan(LaserScan* scan, const WaitHandler& handler)
+{
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    if (m_shuttingDown)
+    {
+        lock.unlock();
+        handler(boost::asio::error::operation_aborted);
+        return;
+    }
+    ScanWaiter waiter = { scan, handler };
+    m_scanWaiters.push_back(waiter);
+    m_scanWaiting = true;
+}
+
+void LDSensor::waitSector(Sector* sector, const WaitHandler& handler)
+{
+    std::unique_lock<std::mutex> lock(m_waitMutex);
+    if (m_shuttingDown)
+    {
+        lock.unlock();
+        handler(boost::asio::error::operation_aborted);
+        return;
+    }
+    SectorWaiter waiter = { sector, handler };
+    m_sectorWaiters.push_back(waiter);
+    m_sectorWaiting = true;
+}
+
+void LDSensor::abortWaits()
+{
+    std::vector<ScanWaiter> scans;
+    std::vector<SectorWaiter> sectors;
+    {
+        std::lock_guard<std::mutex> lock(m_waitMutex);
+        scans.swap(m_scanWaiters);
+        sectors.swap(m_sectorWaiters);
+        m_scanWaiting = false;
+        m_sectorWaiting = false;
+    }
+    for (size_t i = 0; i < scans.size(); ++i)
+    {
+        scans[i].handler(boost::asio::error::operation_aborted);
+    }
+    for (size_t i = 0; i < sectors.size(); ++i)
+    {
+        sectors[i].handler(boost::asio::error::operation_aborted);
+    }
+}
+
+void LDSensor::acquisitionLoop()
+{
+    try
+    {
+        while (!m_shuttingDown)
+        {
+            if (!readFrame(m_frames.writeBuffer())) { break; }
+            deliverFrame();
         }
-        preamble = 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "LDSensor: acquisition stopped: " << e.what() << std::endl;
+        m_failed = true;
     }
 }
 
@@ -0,0 +1,144 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Latency.cpp
+ * @brief Monotonic timestamps and latency histograms
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_Latency.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace HLDS
+{
+
+namespace
+{
+// Position of the highest set bit of a non zero value
+inline int highestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll(value);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return int(index);
+#else
+    int msb = 0;
+    while (value >>= 1) { ++msb; }
+    return msb;
+#endif
+}
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+/*
+ * Values below SubBuckets get a bucket each. Above, the bucket is given
+ * by the position of the highest set bit and the SubBits bits below it.
+ */
+size_t LatencyHistogram::bucket(uint64_t ns)
+{
+    if (ns < SubBuckets) { return size_t(ns); }
+    int msb = highestBit(ns);
+    size_t sub = size_t(ns >> (msb - SubBits)) & (SubBuckets - 1);
+    return (msb - SubBits + 1) * SubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::upperBound(size_t bucket)
+{
+    if (bucket < SubBuckets) { return bucket; }
+    int msb = int(bucket / SubBuckets) + SubBits - 1;
+    uint64_t sub = bucket % SubBuckets;
+    uint64_t low = (uint64_t(SubBuckets + sub)) << (msb - SubBits);
+    return low + (uint64_t(1) << (msb - SubBits)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    std::atomic<uint64_t>& b = m_buckets[bucket(ns)];
+    b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (ns > m_max.load(std::memory_order_relaxed))
+    {
+        m_max.store(ns, std::memory_order_relaxed);
+    }
+}
+
+LatencySummary LatencyHistogram::summary() const
+{
+    uint64_t counts[BucketCount];
+    LatencySummary summary = { 0, 0, 0, 0 };
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        summary.count += counts[i];
+    }
+    summary.max = m_max.load(std::memory_order_relaxed);
+    if (summary.count == 0) { return summary; }
+
+    // Ranks of the percentiles, 1-based
+    uint64_t rank50 = (summary.count + 1) / 2;
+    uint64_t rank99 = summary.count - summary.count / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        if (counts[i] == 0) { continue; }
+        seen += counts[i];
+        if (summary.p50 == 0 && seen >= rank50)
+        {
+            summary.p50 = upperBound(i);
+        }
+        if (seen >= rank99)
+        {
+            summary.p99 = upperBound(i);
+            break;
+        }
+    }
+    // A bucket bound can exceed the largest sample
+    if (summary.p50 > summary.max) { summary.p50 = summary.max; }
+    if (summary.p99 > summary.max) { summary.p99 = summary.max; }
+    return summary;
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i = 0; i < BucketCount; ++i)
+    {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+}
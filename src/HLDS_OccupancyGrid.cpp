@@ -0,0 +1,142 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_OccupancyGrid.cpp
+ * @brief Local occupancy grid updated by ray casting
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_OccupancyGrid.h>
+#include <HLDS_PointCloud.h>
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+// Beam directions of the ray table
+constexpr BeamTrig g_trig = makeBeamTrig();
+
+// Natural log odds of one log odds step
+const double LogOddsUnit = 0.05;
+
+// Ranges are converted to 16.16 fixed point, longer ones leave the grid
+const double MaxFixedRange = 65535.0;
+}
+
+OccupancyGrid::OccupancyGrid()
+  : m_size(0), m_resolution(0.0), m_rayStride(0)
+{
+    memset(m_rayLength, 0, sizeof(m_rayLength));
+    memset(m_rayScale, 0, sizeof(m_rayScale));
+    for (int l = -LogOddsMax; l <= LogOddsMax; ++l)
+    {
+        m_pixel[l + LogOddsMax] =
+            uint8_t(lround(255.0 / (1.0 + exp(-l * LogOddsUnit))));
+    }
+}
+
+void OccupancyGrid::configure(size_t size, double resolution)
+{
+    m_size = std::max(size, size_t(3)) | 1;
+    m_resolution = resolution;
+    m_cells.assign(m_size * m_size, 0);
+    m_image.assign(m_size * m_size, m_pixel[LogOddsMax]);
+
+    // Rays end on the circle inscribed in the grid
+    const int radius = int(m_size / 2);
+    m_rayStride = radius;
+    m_rays.assign(BeamCount * m_rayStride, 0);
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        const int ex = int(lround(radius * g_trig.cos[i]));
+        const int ey = int(lround(radius * g_trig.sin[i]));
+        const int dx = abs(ex), dy = abs(ey);
+        const int sx = ex < 0 ? -1 : 1, sy = ey < 0 ? -1 : 1;
+        const int steps = std::max(dx, dy);
+        int x = 0, y = 0, error = dx - dy;
+        uint32_t* ray = &m_rays[i * m_rayStride];
+        for (int k = 0; k < steps; ++k)
+        {
+            int e2 = 2 * error;
+            if (e2 > -dy) { error -= dy; x += sx; }
+            if (e2 < dx) { error += dx; y += sy; }
+            ray[k] = uint32_t((radius - y) * int(m_size) + radius + x);
+        }
+        m_rayLength[i] = uint16_t(steps);
+        // One step per cell along the major axis of the line
+        double length = sqrt(double(ex) * ex + double(ey) * ey);
+        m_rayScale[i] = steps == 0 ? 0 :
+            uint32_t(lround(steps / length / resolution * 65536.0));
+    }
+}
+
+void OccupancyGrid::clear()
+{
+    std::fill(m_cells.begin(), m_cells.end(), 0);
+    std::fill(m_image.begin(), m_image.end(), m_pixel[LogOddsMax]);
+}
+
+inline void OccupancyGrid::add(uint32_t cell, int step)
+{
+    int value = std::max(-int(LogOddsMax),
+                         std::min(int(LogOddsMax), m_cells[cell] + step));
+    m_cells[cell] = int8_t(value);
+    m_image[cell] = m_pixel[value + LogOddsMax];
+}
+
+void OccupancyGrid::update(const double* ranges)
+{
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        double r = ranges[i];
+        if (!(r > 0.0)) { continue; }
+        const uint32_t* ray = &m_rays[i * m_rayStride];
+        const uint32_t length = m_rayLength[i];
+
+        // Step of the return along the ray, rounded to the nearest cell
+        uint32_t steps = length + 1;
+        if (r < MaxFixedRange)
+        {
+            uint64_t fixed = uint64_t(r * 65536.0);
+            steps = uint32_t(((fixed * m_rayScale[i] >> 31) + 1) >> 1);
+        }
+        if (steps == 0) { continue; }
+        const uint32_t cleared = std::min(steps - 1, length);
+        for (uint32_t k = 0; k < cleared; ++k) { add(ray[k], -MissStep); }
+        if (steps <= length) { add(ray[steps - 1], HitStep); }
+    }
+}
+
+}
@@ -0,0 +1,152 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_PointCloud.cpp
+ * @brief Conversion of a scan to points in the robot frame
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_PointCloud.h>
+#include "HLDS_PointCloudKernels.h"
+#include <iostream>
+#include <math.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+
+// Evaluated by the compiler, nothing is computed at start up
+constexpr BeamTrig g_trig = makeBeamTrig();
+
+void pointsScalar(const MountTransform& mount, const BeamTrig& trig,
+                  const double* ranges, PointScan& points)
+{
+    double* out[3] = { points.x, points.y, points.z };
+    for (int j = 0; j < 3; ++j)
+    {
+        const double ax = mount.x[j], ay = mount.y[j], t = mount.t[j];
+        double* p = out[j];
+        for (int i = 0; i < BeamCount; ++i)
+        {
+            double u = ranges[i] * trig.cos[i];
+            double v = ranges[i] * trig.sin[i];
+            p[i] = (ax * u + ay * v) + t;
+        }
+    }
+}
+
+struct PointKernelSet
+{
+    const char* name;
+    void (*points)(const MountTransform&, const BeamTrig&, const double*,
+                   PointScan&);
+};
+
+/*
+ * Bit exact equivalence check of the kernel against the scalar one, run
+ * once before it is selected, with a tilted and offset mount.
+ */
+bool verify(const PointKernelSet& kernel)
+{
+    double ranges[BeamCount];
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        ranges[i] = (seed >> 29) == 0 ? 0.0 : (seed >> 8) / 4.0e6;
+    }
+    MountTransform mount = makeMountTransform(0.1, -0.2, 0.3,
+                                              0.1, -0.2, 2.5);
+    PointScan expected;
+    PointScan actual;
+    pointsScalar(mount, g_trig, ranges, expected);
+    kernel.points(mount, g_trig, ranges, actual);
+    return memcmp(&expected, &actual, sizeof(expected)) == 0;
+}
+
+PointKernelSet selectKernel()
+{
+    // __builtin_cpu_supports is GCC and Clang only
+#if defined(HLDS_DECODE_AVX2) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        PointKernelSet avx2 = { "AVX2", kernels::pointsAVX2 };
+        if (verify(avx2)) { return avx2; }
+        std::cerr << "scanToPoints: the AVX2 kernel differs from the scalar "
+                  << "conversion, not used" << std::endl;
+    }
+#endif
+    PointKernelSet scalar = { "scalar", pointsScalar };
+    return scalar;
+}
+
+const PointKernelSet& kernel()
+{
+    static const PointKernelSet selected = selectKernel();
+    return selected;
+}
+
+}
+
+MountTransform makeMountTransform(double x, double y, double z,
+                                  double roll, double pitch, double yaw)
+{
+    // First two columns of Rz(yaw) Ry(pitch) Rx(roll)
+    double cr = cos(roll), sr = sin(roll);
+    double cp = cos(pitch), sp = sin(pitch);
+    double cy = cos(yaw), sy = sin(yaw);
+    MountTransform mount;
+    mount.x[0] = cy * cp;
+    mount.x[1] = sy * cp;
+    mount.x[2] = -sp;
+    mount.y[0] = cy * sp * sr - sy * cr;
+    mount.y[1] = sy * sp * sr + cy * cr;
+    mount.y[2] = cp * sr;
+    mount.t[0] = x;
+    mount.t[1] = y;
+    mount.t[2] = z;
+    return mount;
+}
+
+void scanToPoints(const MountTransform& mount, const double* ranges,
+                  PointScan& points)
+{
+    kernel().points(mount, g_trig, ranges, points);
+}
+
+const char* pointKernel()
+{
+    return kernel().name;
+}
+
+}
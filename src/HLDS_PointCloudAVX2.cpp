@@ -0,0 +1,83 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_PointCloudAVX2.cpp
+ * @brief AVX2 point conversion kernel
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HLDS_PointCloudKernels.h"
+
+// This file is compiled with AVX2 code generation enabled and only
+// called after a CPUID check, keep it free of shared inline code.
+#if defined(HLDS_DECODE_AVX2)
+#include <immintrin.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+namespace
+{
+// Four beams per iteration, the 360 beams of a revolution are 90 vectors
+const int Lanes = 4;
+static_assert(BeamCount % Lanes == 0, "scan is not a whole number of vectors");
+}
+
+void pointsAVX2(const MountTransform& mount, const BeamTrig& trig,
+                const double* ranges, PointScan& points)
+{
+    double* out[3] = { points.x, points.y, points.z };
+    __m256d ax[3], ay[3], t[3];
+    for (int j = 0; j < 3; ++j)
+    {
+        ax[j] = _mm256_set1_pd(mount.x[j]);
+        ay[j] = _mm256_set1_pd(mount.y[j]);
+        t[j] = _mm256_set1_pd(mount.t[j]);
+    }
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d r = _mm256_loadu_pd(ranges + i);
+        __m256d u = _mm256_mul_pd(r, _mm256_loadu_pd(trig.cos + i));
+        __m256d v = _mm256_mul_pd(r, _mm256_loadu_pd(trig.sin + i));
+        for (int j = 0; j < 3; ++j)
+        {
+            __m256d p = _mm256_add_pd(_mm256_mul_pd(ax[j], u),
+                                      _mm256_mul_pd(ay[j], v));
+            _mm256_storeu_pd(out[j] + i, _mm256_add_pd(p, t[j]));
+        }
+    }
+}
+
+}
+}
+
+#endif // HLDS_DECODE_AVX2
@@ -0,0 +1,160 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_PublishPolicy.cpp
+ * @brief Per port publication policies
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_PublishPolicy.h>
+#include <stdlib.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+std::string trim(const std::string& text)
+{
+    size_t first = text.find_first_not_of(" \t");
+    if (first == std::string::npos) { return std::string(); }
+    size_t last = text.find_last_not_of(" \t");
+    return text.substr(first, last - first + 1);
+}
+
+bool parseTerm(const std::string& term, PublishPolicy& policy)
+{
+    size_t colon = term.find(':');
+    std::string name(trim(term.substr(0, colon)));
+    std::string value(colon == std::string::npos ? std::string() :
+                      trim(term.substr(colon + 1)));
+    char* end = NULL;
+    if (name == "all" && value.empty())
+    {
+        policy = PublishPolicy();
+        return true;
+    }
+    if (name == "latest" && value.empty())
+    {
+        policy.coalesce = true;
+        return true;
+    }
+    if (name == "every")
+    {
+        long every = strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || every < 1) { return false; }
+        policy.every = uint32_t(every);
+        return true;
+    }
+    if (name == "rate")
+    {
+        double rate = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !(rate > 0.0)) { return false; }
+        policy.period = uint64_t(1e9 / rate);
+        return true;
+    }
+    return false;
+}
+}
+
+bool parsePublishPolicy(const std::string& text, PublishPolicy& policy)
+{
+    PublishPolicy parsed;
+    size_t begin = 0;
+    for (;;)
+    {
+        size_t comma = text.find(',', begin);
+        if (!parseTerm(text.substr(begin, comma - begin), parsed))
+        {
+            return false;
+        }
+        if (comma == std::string::npos) { break; }
+        begin = comma + 1;
+    }
+    policy = parsed;
+    return true;
+}
+
+PublishGate::PublishGate()
+  : m_phase(0), m_due(0), m_pending(false)
+{
+}
+
+void PublishGate::setPolicy(const PublishPolicy& policy)
+{
+    m_policy = policy;
+    m_phase = 0;
+    m_due = 0;
+    m_pending = false;
+}
+
+bool PublishGate::due(uint64_t now)
+{
+    if (m_policy.every > 1)
+    {
+        uint32_t phase = m_phase;
+        m_phase = (m_phase + 1) % m_policy.every;
+        if (phase != 0) { return false; }
+    }
+    if (m_policy.period != 0)
+    {
+        if (m_due != 0 && now < m_due) { return false; }
+        // Late scans keep the average rate, but a pause is not caught up
+        // with a burst
+        if (m_due != 0 && now - m_due < m_policy.period)
+        {
+            m_due += m_policy.period;
+        }
+        else
+        {
+            m_due = now + m_policy.period;
+        }
+    }
+    return true;
+}
+
+bool PublishGate::admit(uint64_t now, bool busy)
+{
+    if (!m_pending && !due(now))
+    {
+        ++m_stats.dropped;
+        return false;
+    }
+    if (busy && m_policy.coalesce)
+    {
+        m_pending = true;
+        ++m_stats.coalesced;
+        return false;
+    }
+    m_pending = false;
+    ++m_stats.published;
+    return true;
+}
+}
@@ -0,0 +1,97 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_Reactor.cpp
+ * @brief I/O event loop shared by the sensors of a process
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_Reactor.h>
+#include <iostream>
+
+
+namespace HLDS
+{
+
+Reactor& Reactor::instance()
+{
+    static Reactor reactor;
+    return reactor;
+}
+
+Reactor::Reactor()
+  : m_io(), m_users(0)
+{
+}
+
+Reactor::~Reactor()
+{
+    m_work.reset();
+    if (m_thread.joinable()) { m_thread.join(); }
+}
+
+void Reactor::acquire()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_users++ > 0) { return; }
+    if (m_thread.joinable()) { m_thread.join(); }
+    m_io.reset();
+    m_work.reset(new boost::asio::io_service::work(m_io));
+    m_thread = std::thread(&Reactor::run, this);
+}
+
+void Reactor::release()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_users == 0 || --m_users > 0) { return; }
+    // Pending handlers of the last user are already done, let run()
+    // return once the queue is empty
+    m_work.reset();
+    m_thread.join();
+}
+
+void Reactor::run()
+{
+    for (;;)
+    {
+        try
+        {
+            m_io.run();
+            return;
+        }
+        catch (const std::exception& e)
+        {
+            // A handler let an exception escape: report it and keep
+            // serving the other sensors
+            std::cerr << "Reactor: " << e.what() << std::endl;
+        }
+    }
+}
+
+}
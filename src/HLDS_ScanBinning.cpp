@@ -0,0 +1,138 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanBinning.cpp
+ * @brief Angular binning of a scan to coarser resolutions
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_ScanBinning.h>
+#include <algorithm>
+#include <limits>
+
+
+namespace HLDS
+{
+
+namespace
+{
+
+void binMin(const BinPlan& plan, const double* ranges, double* bins)
+{
+    const double none = std::numeric_limits<double>::infinity();
+    for (size_t b = 0; b < plan.bins; ++b)
+    {
+        const size_t first = b * plan.width;
+        const size_t last = std::min(first + plan.width, size_t(BeamCount));
+        double nearest = none;
+        for (size_t i = first; i < last; ++i)
+        {
+            nearest = std::min(nearest, ranges[i] > 0.0 ? ranges[i] : none);
+        }
+        bins[b] = nearest == none ? 0.0 : nearest;
+    }
+}
+
+void binMean(const BinPlan& plan, const double* ranges, double* bins)
+{
+    for (size_t b = 0; b < plan.bins; ++b)
+    {
+        const size_t first = b * plan.width;
+        const size_t last = std::min(first + plan.width, size_t(BeamCount));
+        double sum = 0.0;
+        size_t returns = 0;
+        for (size_t i = first; i < last; ++i)
+        {
+            sum += ranges[i];
+            returns += ranges[i] > 0.0;
+        }
+        bins[b] = returns == 0 ? 0.0 : sum / returns;
+    }
+}
+
+void binNearest(const BinPlan& plan, const double* ranges, double* bins)
+{
+    for (size_t b = 0; b < plan.bins; ++b)
+    {
+        const size_t first = b * plan.width;
+        const size_t width = std::min(plan.width, BeamCount - first);
+        double range = 0.0;
+        for (size_t k = 0; k < plan.width && range <= 0.0; ++k)
+        {
+            // Offsets past a narrower last bin are skipped
+            if (plan.order[k] < width) { range = ranges[first + plan.order[k]]; }
+        }
+        bins[b] = range;
+    }
+}
+
+}
+
+BinPlan makeBinPlan(size_t width, BinMode mode)
+{
+    BinPlan plan;
+    plan.width = std::min(width, MaxBinWidth);
+    plan.bins = plan.width > 1 ?
+        (BeamCount + plan.width - 1) / plan.width : 0;
+    plan.mode = mode;
+    // Centre first, then alternately one beam after and one before it
+    const size_t centre = plan.width > 0 ? (plan.width - 1) / 2 : 0;
+    for (size_t k = 0; k < plan.width; ++k)
+    {
+        size_t step = (k + 1) / 2;
+        plan.order[k] = k % 2 == 1 ? centre + step : centre - step;
+    }
+    return plan;
+}
+
+bool binningEnabled(const BinPlan& plan)
+{
+    return plan.bins != 0;
+}
+
+bool parseBinMode(const std::string& name, BinMode& mode)
+{
+    if (name == "min") { mode = BinMin; }
+    else if (name == "mean") { mode = BinMean; }
+    else if (name == "nearest") { mode = BinNearest; }
+    else { return false; }
+    return true;
+}
+
+void binScan(const BinPlan& plan, const double* ranges, double* bins)
+{
+    switch (plan.mode)
+    {
+    case BinMin: binMin(plan, ranges, bins); break;
+    case BinMean: binMean(plan, ranges, bins); break;
+    case BinNearest: binNearest(plan, ranges, bins); break;
+    }
+}
+
+}
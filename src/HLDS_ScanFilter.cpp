@@ -0,0 +1,299 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanFilter.cpp
+ * @brief In place filters of a decoded scan
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_ScanFilter.h>
+#include "HLDS_ScanFilterKernels.h"
+#include <iostream>
+#include <math.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+
+void intensityScalar(double* ranges, const double* intensities, double min)
+{
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        if (intensities[i] < min) { ranges[i] = 0.0; }
+    }
+}
+
+void median3Scalar(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; ++i)
+    {
+        out[i] = kernels::median3(in[i - 1], in[i], in[i + 1]);
+    }
+}
+
+void median5Scalar(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; ++i)
+    {
+        out[i] = kernels::median5(in[i - 2], in[i - 1], in[i],
+                                  in[i + 1], in[i + 2]);
+    }
+}
+
+void shadowScalar(const double* in, double* out, const ScanFilterPlan& plan)
+{
+    for (int i = 0; i < BeamCount; ++i)
+    {
+        double r = in[i];
+        bool veiling = false;
+        for (int k = 1; k <= int(plan.shadowWindow); ++k)
+        {
+            double c = plan.shadowCos[k - 1];
+            double t = plan.shadowTan[k - 1];
+            double n[2] = { in[i - k], in[i + k] };
+            for (size_t j = 0; j < 2; ++j)
+            {
+                // Only the farther point of a pair is dropped
+                veiling |= n[j] > 0.0 && r > n[j] &&
+                           fabs(r - n[j] * c) > n[j] * t;
+            }
+        }
+        out[i] = veiling ? 0.0 : r;
+    }
+}
+
+void speckleScalar(const double* in, double* out, double max_distance)
+{
+    for (int i = 0; i < BeamCount; ++i)
+    {
+        double r = in[i];
+        bool isolated = fabs(r - in[i - 1]) > max_distance &&
+                        fabs(r - in[i + 1]) > max_distance;
+        out[i] = isolated ? 0.0 : r;
+    }
+}
+
+struct FilterKernelSet
+{
+    const char* name;
+    void (*intensity)(double*, const double*, double);
+    void (*median3)(const double*, double*);
+    void (*median5)(const double*, double*);
+    void (*shadow)(const double*, double*, const ScanFilterPlan&);
+    void (*speckle)(const double*, double*, double);
+};
+
+// Copy of the scan with FilterPad beams of wrap around on both sides
+struct PaddedScan
+{
+    double values[BeamCount + 2 * kernels::FilterPad];
+
+    const double* beams() const { return values + kernels::FilterPad; }
+
+    void load(const double* ranges)
+    {
+        const size_t pad = kernels::FilterPad;
+        memcpy(values, ranges + BeamCount - pad, pad * sizeof(double));
+        memcpy(values + pad, ranges, BeamCount * sizeof(double));
+        memcpy(values + pad + BeamCount, ranges, pad * sizeof(double));
+    }
+};
+
+/*
+ * Bit exact equivalence check of the kernels against the scalar ones,
+ * run once before they are selected. The scan mixes no returns, smooth
+ * surfaces, jumps and equal values.
+ */
+bool verify(const FilterKernelSet& kernel)
+{
+    double scan[BeamCount];
+    double intensities[BeamCount];
+    uint32_t seed = 0x2545F491;
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        seed = seed * 1664525 + 1013904223;
+        uint32_t kind = seed >> 29;
+        scan[i] = kind == 0 ? 0.0 :
+                  kind == 1 ? 1.0 :
+                  kind < 5 ? 0.5 + i / 100.0 : (seed >> 8) / 4.0e6;
+        intensities[i] = double((seed >> 12) & 0x3FF);
+    }
+    ScanFilterPlan plan = makeScanFilterPlan(300.0, 3, 10.0 * M_PI / 180.0,
+                                             MaxShadowWindow, 0.1,
+                                             2.0 * M_PI / BeamCount);
+    PaddedScan padded;
+    padded.load(scan);
+    double expected[BeamCount];
+    double actual[BeamCount];
+
+    memcpy(expected, scan, sizeof(scan));
+    memcpy(actual, scan, sizeof(scan));
+    intensityScalar(expected, intensities, plan.minIntensity);
+    kernel.intensity(actual, intensities, plan.minIntensity);
+    if (memcmp(expected, actual, sizeof(expected)) != 0) { return false; }
+
+    median3Scalar(padded.beams(), expected);
+    kernel.median3(padded.beams(), actual);
+    if (memcmp(expected, actual, sizeof(expected)) != 0) { return false; }
+
+    median5Scalar(padded.beams(), expected);
+    kernel.median5(padded.beams(), actual);
+    if (memcmp(expected, actual, sizeof(expected)) != 0) { return false; }
+
+    for (size_t window = 1; window <= MaxShadowWindow; ++window)
+    {
+        plan.shadowWindow = window;
+        shadowScalar(padded.beams(), expected, plan);
+        kernel.shadow(padded.beams(), actual, plan);
+        if (memcmp(expected, actual, sizeof(expected)) != 0) { return false; }
+    }
+
+    speckleScalar(padded.beams(), expected, plan.speckleDistance);
+    kernel.speckle(padded.beams(), actual, plan.speckleDistance);
+    return memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+void rejected(const FilterKernelSet& kernel)
+{
+    std::cerr << "filterScan: the " << kernel.name
+              << " kernels differ from the scalar ones, not used"
+              << std::endl;
+}
+
+FilterKernelSet selectKernel()
+{
+    // __builtin_cpu_supports is GCC and Clang only
+#if defined(HLDS_DECODE_AVX2) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        FilterKernelSet avx2 = { "AVX2", kernels::intensityAVX2,
+                                 kernels::median3AVX2, kernels::median5AVX2,
+                                 kernels::shadowAVX2, kernels::speckleAVX2 };
+        if (verify(avx2)) { return avx2; }
+        rejected(avx2);
+    }
+#endif
+#if defined(HLDS_FILTER_NEON)
+    FilterKernelSet neon = { "NEON", kernels::intensityNEON,
+                             kernels::median3NEON, kernels::median5NEON,
+                             kernels::shadowNEON, kernels::speckleNEON };
+    if (verify(neon)) { return neon; }
+    rejected(neon);
+#endif
+    FilterKernelSet scalar = { "scalar", intensityScalar, median3Scalar,
+                               median5Scalar, shadowScalar, speckleScalar };
+    return scalar;
+}
+
+const FilterKernelSet& kernel()
+{
+    static const FilterKernelSet selected = selectKernel();
+    return selected;
+}
+
+}
+
+ScanFilterPlan makeScanFilterPlan(double min_intensity, size_t median_window,
+                                  double shadow_angle, size_t shadow_window,
+                                  double speckle_distance, double increment)
+{
+    ScanFilterPlan plan;
+    plan.minIntensity = min_intensity > 0.0 ? min_intensity : 0.0;
+    plan.medianWindow = median_window >= 5 ? 5 : median_window >= 3 ? 3 : 0;
+    plan.shadowWindow = shadow_angle > 0.0 ?
+        std::min(shadow_window, MaxShadowWindow) : 0;
+    for (size_t k = 1; k <= MaxShadowWindow; ++k)
+    {
+        plan.shadowCos[k - 1] = cos(k * increment);
+        plan.shadowTan[k - 1] = shadow_angle > 0.0 ?
+            sin(k * increment) / tan(shadow_angle) : 0.0;
+    }
+    plan.speckleDistance = speckle_distance > 0.0 ? speckle_distance : 0.0;
+    return plan;
+}
+
+bool filtersEnabled(const ScanFilterPlan& plan)
+{
+    return plan.minIntensity > 0.0 || plan.medianWindow != 0 ||
+           plan.shadowWindow != 0 || plan.speckleDistance > 0.0;
+}
+
+void filterScan(const ScanFilterPlan& plan, double* ranges,
+                const double* intensities)
+{
+    if (plan.minIntensity > 0.0 && intensities != NULL)
+    {
+        intensityFilter(ranges, intensities, plan.minIntensity);
+    }
+    if (plan.medianWindow != 0) { medianFilter(ranges, plan.medianWindow); }
+    if (plan.shadowWindow != 0) { shadowFilter(ranges, plan); }
+    if (plan.speckleDistance > 0.0)
+    {
+        speckleFilter(ranges, plan.speckleDistance);
+    }
+}
+
+void intensityFilter(double* ranges, const double* intensities,
+                     double min_intensity)
+{
+    kernel().intensity(ranges, intensities, min_intensity);
+}
+
+void medianFilter(double* ranges, size_t window)
+{
+    PaddedScan padded;
+    padded.load(ranges);
+    if (window >= 5) { kernel().median5(padded.beams(), ranges); }
+    else if (window >= 3) { kernel().median3(padded.beams(), ranges); }
+}
+
+void shadowFilter(double* ranges, const ScanFilterPlan& plan)
+{
+    PaddedScan padded;
+    padded.load(ranges);
+    kernel().shadow(padded.beams(), ranges, plan);
+}
+
+void speckleFilter(double* ranges, double max_distance)
+{
+    PaddedScan padded;
+    padded.load(ranges);
+    kernel().speckle(padded.beams(), ranges, max_distance);
+}
+
+const char* filterKernel()
+{
+    return kernel().name;
+}
+
+}
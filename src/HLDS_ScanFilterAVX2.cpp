@@ -0,0 +1,164 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanFilterAVX2.cpp
+ * @brief AVX2 scan filter kernels
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HLDS_ScanFilterKernels.h"
+
+// This file is compiled with AVX2 code generation enabled and only
+// called after a CPUID check, keep it free of shared inline code.
+#if defined(HLDS_DECODE_AVX2)
+#include <immintrin.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+namespace
+{
+/*
+ * Four beams per iteration, the 360 beams of a revolution are 90 full
+ * vectors. A dropped beam is cleared with andnot, which gives +0.0 like
+ * the scalar kernels.
+ */
+const int Lanes = 4;
+static_assert(BeamCount % Lanes == 0, "scan is not a whole number of vectors");
+
+inline __m256d absolute(__m256d x)
+{
+    return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+}
+
+inline __m256d greater(__m256d a, __m256d b)
+{
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+}
+
+inline void sort2(__m256d& a, __m256d& b)
+{
+    __m256d t = _mm256_min_pd(a, b);
+    b = _mm256_max_pd(a, b);
+    a = t;
+}
+
+inline __m256d load(const double* p)
+{
+    return _mm256_loadu_pd(p);
+}
+}
+
+void intensityAVX2(double* ranges, const double* intensities, double min)
+{
+    const __m256d threshold = _mm256_set1_pd(min);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d low = _mm256_cmp_pd(load(intensities + i), threshold,
+                                    _CMP_LT_OQ);
+        _mm256_storeu_pd(ranges + i, _mm256_andnot_pd(low, load(ranges + i)));
+    }
+}
+
+void median3AVX2(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d a = load(in + i - 1);
+        __m256d b = load(in + i);
+        __m256d c = load(in + i + 1);
+        __m256d m = _mm256_max_pd(_mm256_min_pd(a, b),
+                                  _mm256_min_pd(_mm256_max_pd(a, b), c));
+        _mm256_storeu_pd(out + i, m);
+    }
+}
+
+void median5AVX2(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d a = load(in + i - 2);
+        __m256d b = load(in + i - 1);
+        __m256d c = load(in + i);
+        __m256d d = load(in + i + 1);
+        __m256d e = load(in + i + 2);
+        sort2(a, b); sort2(d, e); sort2(a, d);
+        sort2(b, e); sort2(b, c); sort2(c, d);
+        sort2(b, c);
+        _mm256_storeu_pd(out + i, c);
+    }
+}
+
+void shadowAVX2(const double* in, double* out, const ScanFilterPlan& plan)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    const int window = int(plan.shadowWindow);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d r = load(in + i);
+        __m256d veiling = zero;
+        for (int k = 1; k <= window; ++k)
+        {
+            __m256d c = _mm256_set1_pd(plan.shadowCos[k - 1]);
+            __m256d t = _mm256_set1_pd(plan.shadowTan[k - 1]);
+            __m256d n[2] = { load(in + i - k), load(in + i + k) };
+            for (int j = 0; j < 2; ++j)
+            {
+                __m256d m = _mm256_and_pd(greater(n[j], zero),
+                                          greater(r, n[j]));
+                __m256d d = absolute(_mm256_sub_pd(r, _mm256_mul_pd(n[j], c)));
+                m = _mm256_and_pd(m, greater(d, _mm256_mul_pd(n[j], t)));
+                veiling = _mm256_or_pd(veiling, m);
+            }
+        }
+        _mm256_storeu_pd(out + i, _mm256_andnot_pd(veiling, r));
+    }
+}
+
+void speckleAVX2(const double* in, double* out, double max_distance)
+{
+    const __m256d distance = _mm256_set1_pd(max_distance);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        __m256d r = load(in + i);
+        __m256d prev = absolute(_mm256_sub_pd(r, load(in + i - 1)));
+        __m256d next = absolute(_mm256_sub_pd(r, load(in + i + 1)));
+        __m256d isolated = _mm256_and_pd(greater(prev, distance),
+                                         greater(next, distance));
+        _mm256_storeu_pd(out + i, _mm256_andnot_pd(isolated, r));
+    }
+}
+
+}
+}
+
+#endif // HLDS_DECODE_AVX2
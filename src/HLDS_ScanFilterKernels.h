@@ -0,0 +1,107 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanFilterKernels.h
+ * @brief Architecture specific scan filter kernels
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef HLDS_SCANFILTERKERNELS_H
+#define HLDS_SCANFILTERKERNELS_H
+
+#include <HLDS_ScanFilter.h>
+#include <algorithm>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+/*
+ * The window filters read a copy of the scan with FilterPad beams of
+ * the other end of the revolution added on both sides, so every beam
+ * has its neighbours at in[i - k] and in[i + k] and the kernels need no
+ * wrap around. in points at beam 0 of the copy.
+ *
+ * Every kernel has the signature and exact results of the scalar
+ * kernel: only comparisons, min/max, and products and differences
+ * evaluated in the same order without fused multiply-add are used.
+ * Where the compiler would contract a * b - c on its own (AArch64), the
+ * filter sources are built with -ffp-contract=off.
+ */
+const size_t FilterPad = MaxShadowWindow;
+
+static inline double median3(double a, double b, double c)
+{
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// Compare and exchange, a <= b afterwards
+static inline void sort2(double& a, double& b)
+{
+    double t = std::min(a, b);
+    b = std::max(a, b);
+    a = t;
+}
+
+// Exchange network of N. Devillard, "Fast median search", 7 pairs
+static inline double median5(double a, double b, double c, double d,
+                             double e)
+{
+    sort2(a, b); sort2(d, e); sort2(a, d);
+    sort2(b, e); sort2(b, c); sort2(c, d);
+    sort2(b, c);
+    return c;
+}
+
+// NEON kernels need double precision lanes, AArch64 only
+#if defined(HLDS_DECODE_NEON) && defined(__aarch64__)
+#define HLDS_FILTER_NEON
+#endif
+
+#if defined(HLDS_DECODE_AVX2)
+void intensityAVX2(double* ranges, const double* intensities, double min);
+void median3AVX2(const double* in, double* out);
+void median5AVX2(const double* in, double* out);
+void shadowAVX2(const double* in, double* out, const ScanFilterPlan& plan);
+void speckleAVX2(const double* in, double* out, double max_distance);
+#endif
+#if defined(HLDS_FILTER_NEON)
+void intensityNEON(double* ranges, const double* intensities, double min);
+void median3NEON(const double* in, double* out);
+void median5NEON(const double* in, double* out);
+void shadowNEON(const double* in, double* out, const ScanFilterPlan& plan);
+void speckleNEON(const double* in, double* out, double max_distance);
+#endif
+
+}
+}
+
+#endif // HLDS_SCANFILTERKERNELS_H
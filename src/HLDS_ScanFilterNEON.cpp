@@ -0,0 +1,160 @@
+// -*- C++ -*-
+/*!
+ * @file src/HLDS_ScanFilterNEON.cpp
+ * @brief NEON scan filter kernels
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "HLDS_ScanFilterKernels.h"
+
+// Double precision lanes exist on AArch64 only, 32-bit ARM runs the
+// scalar kernels. Keep this file free of shared inline code, like the
+// other kernel files.
+#if defined(HLDS_FILTER_NEON)
+#include <arm_neon.h>
+
+
+namespace HLDS
+{
+namespace kernels
+{
+
+namespace
+{
+/*
+ * Two beams per iteration, the 360 beams of a revolution are 180 full
+ * vectors. A dropped beam is cleared with bic, which gives +0.0 like
+ * the scalar kernels.
+ */
+const int Lanes = 2;
+static_assert(BeamCount % Lanes == 0, "scan is not a whole number of vectors");
+
+inline float64x2_t clear(uint64x2_t mask, float64x2_t x)
+{
+    return vreinterpretq_f64_u64(vbicq_u64(vreinterpretq_u64_f64(x), mask));
+}
+
+inline void sort2(float64x2_t& a, float64x2_t& b)
+{
+    float64x2_t t = vminq_f64(a, b);
+    b = vmaxq_f64(a, b);
+    a = t;
+}
+
+inline float64x2_t load(const double* p)
+{
+    return vld1q_f64(p);
+}
+}
+
+void intensityNEON(double* ranges, const double* intensities, double min)
+{
+    const float64x2_t threshold = vdupq_n_f64(min);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        uint64x2_t low = vcltq_f64(load(intensities + i), threshold);
+        vst1q_f64(ranges + i, clear(low, load(ranges + i)));
+    }
+}
+
+void median3NEON(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        float64x2_t a = load(in + i - 1);
+        float64x2_t b = load(in + i);
+        float64x2_t c = load(in + i + 1);
+        float64x2_t m = vmaxq_f64(vminq_f64(a, b),
+                                  vminq_f64(vmaxq_f64(a, b), c));
+        vst1q_f64(out + i, m);
+    }
+}
+
+void median5NEON(const double* in, double* out)
+{
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        float64x2_t a = load(in + i - 2);
+        float64x2_t b = load(in + i - 1);
+        float64x2_t c = load(in + i);
+        float64x2_t d = load(in + i + 1);
+        float64x2_t e = load(in + i + 2);
+        sort2(a, b); sort2(d, e); sort2(a, d);
+        sort2(b, e); sort2(b, c); sort2(c, d);
+        sort2(b, c);
+        vst1q_f64(out + i, c);
+    }
+}
+
+void shadowNEON(const double* in, double* out, const ScanFilterPlan& plan)
+{
+    const float64x2_t zero = vdupq_n_f64(0.0);
+    const int window = int(plan.shadowWindow);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        float64x2_t r = load(in + i);
+        uint64x2_t veiling = vdupq_n_u64(0);
+        for (int k = 1; k <= window; ++k)
+        {
+            float64x2_t c = vdupq_n_f64(plan.shadowCos[k - 1]);
+            float64x2_t t = vdupq_n_f64(plan.shadowTan[k - 1]);
+            float64x2_t n[2] = { load(in + i - k), load(in + i + k) };
+            for (int j = 0; j < 2; ++j)
+            {
+                uint64x2_t m = vandq_u64(vcgtq_f64(n[j], zero),
+                                         vcgtq_f64(r, n[j]));
+                // Separate multiply and subtract, no fused vfmsq
+                float64x2_t d = vabsq_f64(vsubq_f64(r, vmulq_f64(n[j], c)));
+                m = vandq_u64(m, vcgtq_f64(d, vmulq_f64(n[j], t)));
+                veiling = vorrq_u64(veiling, m);
+            }
+        }
+        vst1q_f64(out + i, clear(veiling, r));
+    }
+}
+
+void speckleNEON(const double* in, double* out, double max_distance)
+{
+    const float64x2_t distance = vdupq_n_f64(max_distance);
+    for (int i = 0; i < BeamCount; i += Lanes)
+    {
+        float64x2_t r = load(in + i);
+        float64x2_t prev = vabdq_f64(r, load(in + i - 1));
+        float64x2_t next = vabdq_f64(r, load(in + i + 1));
+        uint64x2_t isolated = vandq_u64(vcgtq_f64(prev, distance),
+                                        vcgtq_f64(next, distance));
+        vst1q_f64(out + i, clear(isolated, r));
+    }
+}
+
+}
+}
+
+#endif // HLDS_FILTER_NEON
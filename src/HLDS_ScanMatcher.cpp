@@ -0,0 +1,293 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_ScanMatcher.cpp
+ * @brief Scan to scan matching odometry
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_ScanMatcher.h>
+#include <HLDS_PointCloud.h>
+#include <math.h>
+#include <string.h>
+
+
+namespace HLDS
+{
+
+namespace
+{
+// Beam directions of the loaded points
+constexpr BeamTrig g_trig = makeBeamTrig();
+
+// A step below these ends the iterations
+const double MinTranslationStep = 1e-6;
+const double MinRotationStep = 1e-6;
+// Points on either side of a point its surface normal is fitted to
+const size_t NormalReach = 2;
+// Share of the pairs that has to constrain the weakest direction of the
+// motion, below it the scene (a corridor, a round room) leaves the
+// motion along that direction to the noise
+const double MinConstraint = 0.025;
+}
+
+ScanMatcher::ScanMatcher()
+  : m_maxDistance(0.0), m_cellScale(0.0), m_maxIterations(0),
+    m_reference(-1), m_matches(0), m_iterations(0), m_rmsError(0.0)
+{
+    configure(0.3, 20);
+}
+
+void ScanMatcher::configure(double max_distance, size_t max_iterations)
+{
+    m_maxDistance = max_distance;
+    m_cellScale = 1.0 / max_distance;
+    m_maxIterations = max_iterations;
+    reset();
+}
+
+void ScanMatcher::reset()
+{
+    m_reference = -1;
+    m_guess.x = m_guess.y = m_guess.heading = 0.0;
+    m_matches = 0;
+    m_iterations = 0;
+    m_rmsError = 0.0;
+}
+
+void ScanMatcher::load(const double* ranges, Scan& scan) const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < BeamCount; ++i)
+    {
+        if (!(ranges[i] > 0.0)) { continue; }
+        scan.x[count] = ranges[i] * g_trig.cos[i];
+        scan.y[count] = ranges[i] * g_trig.sin[i];
+        ++count;
+    }
+    scan.count = count;
+
+    // Normal of the line through the neighbours on the same surface, up
+    // to NormalReach points on either side as long as each is closer
+    // than the correspondence distance to the next. The wider base keeps
+    // the range noise out of the normals, which would otherwise pass for
+    // a constraint along a corridor.
+    const double max2 = m_maxDistance * m_maxDistance;
+    for (size_t j = 0; j < count; ++j)
+    {
+        size_t a = j, b = j;
+        while (a > 0 && j - a < NormalReach &&
+               distance2(scan, a - 1, a) < max2)
+        {
+            --a;
+        }
+        while (b + 1 < count && b - j < NormalReach &&
+               distance2(scan, b, b + 1) < max2)
+        {
+            ++b;
+        }
+        double dx = scan.x[b] - scan.x[a];
+        double dy = scan.y[b] - scan.y[a];
+        double length = sqrt(dx * dx + dy * dy);
+        scan.nx[j] = length > 0.0 ? -dy / length : 0.0;
+        scan.ny[j] = length > 0.0 ? dx / length : 0.0;
+    }
+}
+
+double ScanMatcher::distance2(const Scan& scan, size_t a, size_t b)
+{
+    double dx = scan.x[b] - scan.x[a];
+    double dy = scan.y[b] - scan.y[a];
+    return dx * dx + dy * dy;
+}
+
+int32_t ScanMatcher::cell(double coordinate) const
+{
+    return int32_t(floor(coordinate * m_cellScale));
+}
+
+uint32_t ScanMatcher::bucket(int32_t cx, int32_t cy)
+{
+    return (uint32_t(cx) * 73856093u ^ uint32_t(cy) * 19349663u) &
+           (BucketCount - 1);
+}
+
+void ScanMatcher::index(Scan& scan) const
+{
+    // Counting sort of the points by bucket
+    uint16_t bucket_of[BeamCount];
+    memset(scan.first, 0, sizeof(scan.first));
+    for (size_t j = 0; j < scan.count; ++j)
+    {
+        bucket_of[j] = uint16_t(bucket(cell(scan.x[j]), cell(scan.y[j])));
+        ++scan.first[bucket_of[j] + 1];
+    }
+    for (size_t b = 0; b < BucketCount; ++b)
+    {
+        scan.first[b + 1] += scan.first[b];
+    }
+    uint16_t next[BucketCount];
+    memcpy(next, scan.first, sizeof(next));
+    for (size_t j = 0; j < scan.count; ++j)
+    {
+        scan.order[next[bucket_of[j]]++] = uint16_t(j);
+    }
+}
+
+int ScanMatcher::nearest(const Scan& scan, double x, double y) const
+{
+    // The cell of the point and its neighbours hold every point within
+    // one cell size
+    const int32_t cx = cell(x), cy = cell(y);
+    double best = m_maxDistance * m_maxDistance;
+    int found = -1;
+    for (int32_t i = cx - 1; i <= cx + 1; ++i)
+    {
+        for (int32_t k = cy - 1; k <= cy + 1; ++k)
+        {
+            uint32_t b = bucket(i, k);
+            for (uint16_t n = scan.first[b]; n < scan.first[b + 1]; ++n)
+            {
+                int j = scan.order[n];
+                double dx = scan.x[j] - x, dy = scan.y[j] - y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 < best && (scan.nx[j] != 0.0 || scan.ny[j] != 0.0))
+                {
+                    best = d2;
+                    found = j;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+bool ScanMatcher::match(const double* ranges, Motion2D& motion)
+{
+    const int current = m_reference == 0 ? 1 : 0;
+    Scan& scan = m_scans[current];
+    load(ranges, scan);
+    index(scan);
+    const int reference = m_reference;
+    m_reference = current;
+    m_matches = 0;
+    m_iterations = 0;
+    if (reference < 0) { return false; }
+    const Scan& ref = m_scans[reference];
+
+    double heading = m_guess.heading, tx = m_guess.x, ty = m_guess.y;
+    size_t pairs = 0;
+    double squares = 0.0;
+    for (size_t it = 0; it < m_maxIterations; ++it)
+    {
+        // Normal equations of the point to line distances, for a
+        // rotation about the origin followed by a translation
+        double h[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+        double g[3] = { 0.0, 0.0, 0.0 };
+        double lever = 0.0;
+        const double c = cos(heading), s = sin(heading);
+        pairs = 0;
+        squares = 0.0;
+        for (size_t j = 0; j < scan.count; ++j)
+        {
+            double px = c * scan.x[j] - s * scan.y[j] + tx;
+            double py = s * scan.x[j] + c * scan.y[j] + ty;
+            int q = nearest(ref, px, py);
+            if (q < 0) { continue; }
+            double nx = ref.nx[q], ny = ref.ny[q];
+            double e = nx * (px - ref.x[q]) + ny * (py - ref.y[q]);
+            double jt = ny * px - nx * py;
+            h[0] += nx * nx; h[1] += nx * ny; h[2] += nx * jt;
+            h[3] += ny * ny; h[4] += ny * jt; h[5] += jt * jt;
+            g[0] += nx * e; g[1] += ny * e; g[2] += jt * e;
+            squares += e * e;
+            lever += px * px + py * py;
+            ++pairs;
+        }
+        if (pairs < MinMatches) { break; }
+
+        // A degenerate scene has no unique solution. The normals are
+        // unit vectors, so the trace of the translation block is the
+        // number of pairs and its smallest eigenvalue the number of
+        // pairs, in effect, across the weakest direction: near 0 along
+        // a corridor. The rotation is judged by what is left of h[5]
+        // once the translation is free, det(h) / det(translation
+        // block), against the squared lever arms of the pairs: near 0
+        // at the centre of a round room.
+        double trace = h[0] + h[3];
+        double spread = sqrt(0.25 * (h[0] - h[3]) * (h[0] - h[3]) +
+                             h[1] * h[1]);
+        double c00 = h[3] * h[5] - h[4] * h[4];
+        double c01 = h[2] * h[4] - h[1] * h[5];
+        double c02 = h[1] * h[4] - h[2] * h[3];
+        double det = h[0] * c00 + h[1] * c01 + h[2] * c02;
+        double c22 = h[0] * h[3] - h[1] * h[1];
+        if (!(0.5 * trace - spread > MinConstraint * trace) ||
+            !(det > MinConstraint * lever * c22))
+        {
+            pairs = 0;
+            break;
+        }
+        // Solve h * d = -g by Cramer's rule
+        double c11 = h[0] * h[5] - h[2] * h[2];
+        double c12 = h[1] * h[2] - h[0] * h[4];
+        double dx = -(c00 * g[0] + c01 * g[1] + c02 * g[2]) / det;
+        double dy = -(c01 * g[0] + c11 * g[1] + c12 * g[2]) / det;
+        double dt = -(c02 * g[0] + c12 * g[1] + c22 * g[2]) / det;
+
+        // Compose the step with the estimate
+        double dc = cos(dt), ds = sin(dt);
+        double x = dc * tx - ds * ty + dx;
+        ty = ds * tx + dc * ty + dy;
+        tx = x;
+        heading += dt;
+        ++m_iterations;
+        if (fabs(dx) + fabs(dy) < MinTranslationStep &&
+            fabs(dt) < MinRotationStep)
+        {
+            break;
+        }
+    }
+
+    m_matches = pairs;
+    if (pairs < MinMatches)
+    {
+        m_guess.x = m_guess.y = m_guess.heading = 0.0;
+        m_rmsError = 0.0;
+        return false;
+    }
+    m_rmsError = sqrt(squares / pairs);
+    m_guess.x = tx;
+    m_guess.y = ty;
+    m_guess.heading = atan2(sin(heading), cos(heading));
+    motion = m_guess;
+    return true;
+}
+
+}
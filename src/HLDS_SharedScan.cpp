@@ -0,0 +1,314 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_SharedScan.cpp
+ * @brief Scan ring in POSIX shared memory for consumers on the same host
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_SharedScan.h>
+#include <algorithm>
+#include <errno.h>
+#include <stdexcept>
+#include <string.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace HLDS
+{
+
+using namespace SharedScanLayout;
+
+// Readers map the segment read-only, loads of the ring atomics must not
+// write to it
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "the shared scan ring needs lock-free atomics");
+
+namespace
+{
+std::string segmentName(const std::string& name)
+{
+    return name.compare(0, 1, "/") == 0 ? name : "/" + name;
+}
+
+#if !defined(_WIN32)
+std::runtime_error segmentError(const std::string& what,
+                                const std::string& name)
+{
+    return std::runtime_error(what + " shared memory " + name + ": " +
+                              strerror(errno));
+}
+
+bool sameLayout(const Header* header, size_t size)
+{
+    return header->magic.load(std::memory_order_acquire) == Magic &&
+        header->version == Version && header->slotSize == sizeof(Slot) &&
+        SharedScanLayout::size(header->slots) == size;
+}
+#endif
+}
+
+SharedScanWriter::SharedScanWriter()
+  : m_header(NULL), m_slots(NULL), m_size(0), m_number(0)
+{
+}
+
+SharedScanWriter::~SharedScanWriter()
+{
+    close();
+}
+
+#if !defined(_WIN32)
+void SharedScanWriter::open(const std::string& name, size_t slots)
+{
+    close();
+    if (slots < 2)
+    {
+        throw std::runtime_error("a shared scan ring needs 2 slots or more");
+    }
+    std::string path(segmentName(name));
+    size_t size = SharedScanLayout::size(slots);
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) { throw segmentError("cannot create", path); }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw segmentError("cannot stat", path);
+    }
+    if (st.st_size != 0 && size_t(st.st_size) != size)
+    {
+        // Readers of the old layout keep their mapping, but never see
+        // another scan
+        ::close(fd);
+        shm_unlink(path.c_str());
+        fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0) { throw segmentError("cannot create", path); }
+        st.st_size = 0;
+    }
+    if (st.st_size == 0 && ftruncate(fd, size) != 0)
+    {
+        ::close(fd);
+        throw segmentError("cannot size", path);
+    }
+    void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) { throw segmentError("cannot map", path); }
+
+    m_name = path;
+    m_header = static_cast<Header*>(data);
+    m_slots = reinterpret_cast<Slot*>(static_cast<uint8_t*>(data) +
+                                      sizeof(Header));
+    m_size = size;
+    if (sameLayout(m_header, size))
+    {
+        m_number = m_header->head.load(std::memory_order_relaxed);
+        return;
+    }
+    // New segment, or one left half initialised. Readers accept it once
+    // the magic is set.
+    m_header->magic.store(0, std::memory_order_relaxed);
+    memset(static_cast<void*>(m_slots), 0, slots * sizeof(Slot));
+    m_header->version = Version;
+    m_header->slots = uint32_t(slots);
+    m_header->slotSize = sizeof(Slot);
+    m_header->head.store(0, std::memory_order_relaxed);
+    m_header->magic.store(Magic, std::memory_order_release);
+    m_number = 0;
+}
+
+void SharedScanWriter::close()
+{
+    if (m_header == NULL) { return; }
+    munmap(static_cast<void*>(m_header), m_size);
+    m_header = NULL;
+    m_slots = NULL;
+    m_size = 0;
+}
+
+void SharedScanWriter::unlink(const std::string& name)
+{
+    shm_unlink(segmentName(name).c_str());
+}
+#else
+void SharedScanWriter::open(const std::string& name, size_t slots)
+{
+    throw std::runtime_error("shared memory scans are not supported on "
+                             "Windows");
+}
+
+void SharedScanWriter::close()
+{
+}
+
+void SharedScanWriter::unlink(const std::string& name)
+{
+}
+#endif
+
+SharedScan& SharedScanWriter::beginWrite()
+{
+    // Odd while written. A slot a crashed writer left odd stays odd.
+    Slot& slot = m_slots[(m_number + 1) % m_header->slots];
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) | 1,
+                        std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot.scan;
+}
+
+void SharedScanWriter::publish()
+{
+    ++m_number;
+    Slot& slot = m_slots[m_number % m_header->slots];
+    slot.scan.number = m_number;
+    slot.sequence.store(slot.sequence.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+    m_header->head.store(m_number, std::memory_order_release);
+}
+
+SharedScanReader::SharedScanReader()
+  : m_header(NULL), m_slots(NULL), m_size(0), m_last(0)
+{
+}
+
+SharedScanReader::~SharedScanReader()
+{
+    close();
+}
+
+#if !defined(_WIN32)
+void SharedScanReader::open(const std::string& name)
+{
+    close();
+    std::string path(segmentName(name));
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0) { throw segmentError("cannot open", path); }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw segmentError("cannot stat", path);
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(Header))
+    {
+        ::close(fd);
+        throw std::runtime_error("not a shared scan ring: " + path);
+    }
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) { throw segmentError("cannot map", path); }
+    const Header* header = static_cast<const Header*>(data);
+    if (!sameLayout(header, size))
+    {
+        munmap(data, size);
+        throw std::runtime_error("not a shared scan ring of this version: " +
+                                 path);
+    }
+    m_header = header;
+    m_slots = reinterpret_cast<const Slot*>(static_cast<const uint8_t*>(data) +
+                                            sizeof(Header));
+    m_size = size;
+    m_last = 0;
+}
+
+void SharedScanReader::close()
+{
+    if (m_header == NULL) { return; }
+    munmap(const_cast<Header*>(m_header), m_size);
+    m_header = NULL;
+    m_slots = NULL;
+    m_size = 0;
+}
+#else
+void SharedScanReader::open(const std::string& name)
+{
+    throw std::runtime_error("shared memory scans are not supported on "
+                             "Windows");
+}
+
+void SharedScanReader::close()
+{
+}
+#endif
+
+bool SharedScanReader::read(uint64_t number, SharedScan& scan) const
+{
+    const Slot& slot = m_slots[number % m_header->slots];
+    uint32_t before = slot.sequence.load(std::memory_order_acquire);
+    if ((before & 1) != 0) { return false; }
+    // The copy may race with the writer, it is only used if the sequence
+    // shows it did not
+    memcpy(static_cast<void*>(&scan), &slot.scan, sizeof(scan));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t after = slot.sequence.load(std::memory_order_relaxed);
+    return before == after && scan.number == number;
+}
+
+bool SharedScanReader::latest(SharedScan& scan)
+{
+    for (;;)
+    {
+        uint64_t head = m_header->head.load(std::memory_order_acquire);
+        if (head == 0) { return false; }
+        // Fails only if the writer has since come round to this slot
+        if (read(head, scan))
+        {
+            m_last = head;
+            return true;
+        }
+    }
+}
+
+bool SharedScanReader::next(SharedScan& scan)
+{
+    for (;;)
+    {
+        uint64_t head = m_header->head.load(std::memory_order_acquire);
+        // A writer that reinitialised the ring starts over at 1
+        if (head < m_last) { m_last = 0; }
+        if (head == m_last) { return false; }
+        // The slot after the head may be in the writer's hands already
+        uint64_t number = m_last + 1;
+        uint64_t oldest = head - std::min<uint64_t>(head,
+                                                    m_header->slots - 2);
+        if (number < oldest) { number = oldest; }
+        if (read(number, scan))
+        {
+            m_last = number;
+            return true;
+        }
+    }
+}
+}
@@ -0,0 +1,149 @@
+// -*- C++ -*-
+/*!
+ * @file HLDS_SpeedEstimator.cpp
+ * @brief Rotation speed and revolution period estimation
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <HLDS_SpeedEstimator.h>
+#include <algorithm>
+#include <cstdlib>
+
+
+namespace HLDS
+{
+
+uint64_t reportedPeriod(const RawFrame& frame)
+{
+    uint16_t speeds[PacketCount];
+    size_t count = 0;
+    for (uint16_t n = 0; n < PacketCount; ++n)
+    {
+        if (((frame.valid >> n) & 1) == 0) { continue; }
+        const uint8_t* packet = frame.bytes + n * PacketLength;
+        uint16_t speed = uint16_t(packet[2] | (packet[3] << 8));
+        if (speed != 0) { speeds[count++] = speed; }
+    }
+    if (count == 0) { return 0; }
+    std::nth_element(speeds, speeds + count / 2, speeds + count);
+    // 60 s per revolution at speed / 10 rpm
+    return 600000000000ULL / speeds[count / 2];
+}
+
+SpeedEstimator::SpeedEstimator()
+  : m_period(0), m_phase(0), m_reported(0), m_misses(0), m_rejected(0)
+{
+}
+
+void SpeedEstimator::reset()
+{
+    m_period = 0;
+    m_phase = 0;
+    m_reported = 0;
+    m_misses = 0;
+}
+
+uint64_t SpeedEstimator::period() const
+{
+    return uint64_t(m_period + (1 << (FractionBits - 1))) >> FractionBits;
+}
+
+double SpeedEstimator::rpm() const
+{
+    uint64_t current = period();
+    return current != 0 ? 60e9 / current : 0.0;
+}
+
+void SpeedEstimator::restart(uint64_t reported, uint64_t seed,
+                             uint64_t time)
+{
+    m_reported = reported;
+    m_period = seed >= MinPeriod && seed <= MaxPeriod ?
+        int64_t(seed) << FractionBits : 0;
+    m_phase = time;
+    m_misses = 0;
+}
+
+bool SpeedEstimator::reject()
+{
+    ++m_rejected;
+    if (++m_misses < RejectLimit) { return false; }
+    reset();
+    return true;
+}
+
+uint64_t SpeedEstimator::update(const RawFrame& frame)
+{
+    uint64_t reported = reportedPeriod(frame);
+    uint64_t time = frame.completeTime;
+    int64_t estimate = int64_t(period());
+    if (estimate == 0)
+    {
+        // The sensor's own figure, or else the first interval
+        uint64_t seed = reported;
+        if (seed == 0 && m_phase != 0 && time > m_phase)
+        {
+            seed = time - m_phase;
+        }
+        restart(reported, seed, time);
+        return period();
+    }
+    // A change of the reported speed rather than its value, the sensor's
+    // clock need not agree with ours
+    int64_t tolerance = estimate * Tolerance / 100;
+    if (reported != 0 && m_reported != 0 &&
+        std::abs(int64_t(reported) - int64_t(m_reported)) >
+        int64_t(m_reported) * Tolerance / 100)
+    {
+        if (reject()) { restart(reported, reported, time); }
+        return period();
+    }
+
+    int64_t elapsed = int64_t(time - m_phase);
+    int64_t turns = (elapsed + estimate / 2) / estimate;
+    if (turns > MaxTurns)
+    {
+        // Too long a gap to count the revolutions in it, e.g. a stall of
+        // the reader
+        m_phase = time;
+        return period();
+    }
+    int64_t residual = elapsed - turns * estimate;
+    if (turns == 0 || std::abs(residual) > tolerance)
+    {
+        if (reject()) { restart(reported, reported, time); }
+        return period();
+    }
+    m_misses = 0;
+    m_phase = time - residual + residual / PhaseGain;
+    m_period += (residual << FractionBits) / (PeriodGain * turns);
+    return period();
+}
+}
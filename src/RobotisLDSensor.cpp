@@ -1,307 +1,1190 @@
-﻿// -*- C++ -*-
-/*!
- * @file  RobotisLDSensor.cpp
- * @brief Robotis LDS-01 RTC
- * @date $Date$
- *
- * $Id$
- */
-
-#include "RobotisLDSensor.h"
-
-#include <iostream>
-#include <iomanip>
-#include <algorithm>
-
-// Module specification
-// <rtc-template block="module_spec">
-static const char* robotisldsensor_spec[] =
-  {
-    "implementation_id", "RobotisLDSensor",
-    "type_name",         "RobotisLDSensor",
-    "description",       "Robotis LDS-01 RTC",
-    "version",           "1.0.0",
-    "vendor",            "aist",
-    "category",          "Sensor",
-    "activity_type",     "PERIODIC",
-    "kind",              "DataFlowComponent",
-    "max_instance",      "1",
-    "language",          "C++",
-    "lang_type",         "compile",
-    // Configuration variables
-    "conf.default.port_name", "/dev/ttyUSB0",
-    "conf.default.baudrate", "230400",
-    "conf.default.debug", "0",
-    "conf.default.scale", "1.0",
-    "conf.default.offset", "5.0",
-    "conf.default.geometry_x", "0.0",
-    "conf.default.geometry_y", "0.0",
-    "conf.default.geometry_z", "0.0",
-
-    // Widget
-    "conf.__widget__.port_name", "text",
-    "conf.__widget__.baudrate", "text",
-    "conf.__widget__.debug", "radio",
-    "conf.__widget__.scale", "slider.0.001",
-    "conf.__widget__.offset", "slider",
-    "conf.__widget__.geometry_x", "text",
-    "conf.__widget__.geometry_y", "text",
-    "conf.__widget__.geometry_z", "text",
-    // Constraints
-    "conf.__constraints__.debug", "(0, 1)",
-    "conf.__constraints__.scale", "0.001<x<1000.0",
-    "conf.__constraints__.offset", "-180.0<x<180.0",
-
-    "conf.__type__.port_name", "string",
-    "conf.__type__.baudrate", "int",
-    "conf.__type__.debug", "int",
-    "conf.__type__.scale", "float",
-    "conf.__type__.offset", "double",
-    "conf.__type__.geometry_x", "double",
-    "conf.__type__.geometry_y", "double",
-    "conf.__type__.geometry_z", "double",
-
-    ""
-  };
-// </rtc-template>
-
-/*!
- * @brief constructor
- * @param manager Maneger Object
- */
-RobotisLDSensor::RobotisLDSensor(RTC::Manager* manager)
-    // <rtc-template block="initializer">
-  : RTC::DataFlowComponentBase(manager),
-    m_rangeOut("range", m_range)
-
-    // </rtc-template>
-{
-}
-
-/*!
- * @brief destructor
- */
-RobotisLDSensor::~RobotisLDSensor()
-{
-}
-
-
-
-RTC::ReturnCode_t RobotisLDSensor::onInitialize()
-{
-  // Registration: InPort/OutPort/Service
-  // <rtc-template block="registration">
-  // Set InPort buffers
-
-  // Set OutPort buffer
-  addOutPort("range", m_rangeOut);
-
-  // Set service provider to Ports
-
-  // Set service consumers to Ports
-
-  // Set CORBA Service Ports
-
-  // </rtc-template>
-
-  // <rtc-template block="bind_config">
-  // Bind variables and configuration variable
-  bindParameter("port_name", m_port_name, "/dev/ttyUSB0");
-  bindParameter("baudrate", m_baudrate, "230400");
-  bindParameter("debug", m_debug, "0");
-  bindParameter("scale", m_scale, "1.0");
-  bindParameter("offset", m_offset, "5.0");
-  bindParameter("geometry_x", m_geometry_x, "0.0");
-  bindParameter("geometry_y", m_geometry_y, "0.0");
-  bindParameter("geometry_z", m_geometry_z, "0.0");
-  // </rtc-template>
-
-
-  return RTC::RTC_OK;
-}
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onFinalize()
-{
-  return RTC::RTC_OK;
-}
-*/
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onStartup(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onShutdown(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-
-RTC::ReturnCode_t RobotisLDSensor::onActivated(RTC::UniqueId ec_id)
-{
-    RTC_DEBUG(("onActivated()"));
-    try
-    {
-        m_ldsensor = new HLDS::LDSensor(m_port_name, m_baudrate);
-    }
-    catch (...)
-    {
-        RTC_DEBUG(("LDSensor device open failed"));
-        RTC_DEBUG(("Port name: %s", m_port_name));
-        RTC_DEBUG(("Baud rate: %d", m_baudrate));
-        return RTC::RTC_ERROR; 
-    }
-    RTC_INFO(("LDSensor opened: %s, %d", m_port_name, m_baudrate));
-
-    m_range.geometry.geometry.pose.position.x = m_geometry_x;
-    m_range.geometry.geometry.pose.position.y = m_geometry_y;
-    m_range.geometry.geometry.pose.position.z = m_geometry_z;
-    m_range.geometry.geometry.pose.orientation.r = 0.0;
-    m_range.geometry.geometry.pose.orientation.p = 0.0;
-    m_range.geometry.geometry.pose.orientation.y = 0.0;
-
-    return RTC::RTC_OK;
-}
-
-
-RTC::ReturnCode_t RobotisLDSensor::onDeactivated(RTC::UniqueId ec_id)
-{
-    m_ldsensor->stopMotor();
-    RTC_DEBUG(("LDSensor motor stopped."));
-    m_ldsensor->close();
-    RTC_DEBUG(("LDSensor device closed."));
-    delete m_ldsensor;
-    RTC_PARANOID(("LDSensor object deleted."));
-    return RTC::RTC_OK;
-}
-
-
-RTC::ReturnCode_t RobotisLDSensor::onExecute(RTC::UniqueId ec_id)
-{
-    HLDS::LaserScan scan;
-    m_ldsensor->poll(scan);
-    size_t count = scan.ranges.size();
-    double incr = scan.angle_increment;
-    // https://emanual.robotis.com/assets/docs/LDS_Basic_Specification.pdf
-    m_range.config.minAngle = scan.angle_min;
-    m_range.config.maxAngle = scan.angle_max;
-    // spec: angular resolution = 1 degree
-    m_range.config.angularRes = incr;
-    m_range.config.minRange = 120 / 1000.0;
-    m_range.config.maxRange = 3500 / 1000.0;
-    m_range.config.rangeRes = 15 / 1000.0; // 15mm (12mm-499mm)
-    // spec: 300+-10rpm, 
-    m_range.config.frequency = m_ldsensor->rpm() / 60.0; // rpm->Hz spec 1.8kHz
-
-    if (m_debug == 1)
-      {
-        std::cout << "min angle: " << scan.angle_min << std::endl;
-        std::cout << "min angle: " << scan.angle_min * 180 / M_PI << " [deg]" << std::endl;
-        std::cout << "max angle: " << scan.angle_max << std::endl;
-        std::cout << "max angle: " << scan.angle_max * 180 / M_PI << " [deg]" << std::endl;
-        std::cout << "angle res: " << incr << std::endl;
-        std::cout << "angle res: " << incr * 180 / M_PI << " [deg]" << std::endl;
-        std::cout << "min range: " << m_range.config.minRange << " [m]"<< std::endl;
-        std::cout << "max range: " << m_range.config.maxRange << " [m]" << std::endl;
-        std::cout << "range res: " << m_range.config.rangeRes << " [m]" << std::endl;
-        std::cout << "freq:      " << m_ldsensor->rpm() << " [rpm]" << std::endl;
-        std::cout << "freq:      " << m_range.config.frequency << " [Hz]" << std::endl;
-        std::cout << "range num: " << count << std::endl; 
-      }
-
-    m_range.ranges.length(count);
-    for (size_t i = 0; i < scan.ranges.size(); ++i)
-    {
-      // angluar offset
-      // offset[rad]/angular_resolution[rad/index] => index_offset
-      // index_offset % range_index_size => shifted index
-      int i_d;
-      if (m_offset < 0)
-        {
-          i_d = (i - int((m_offset / 180 * M_PI) / incr)) % count;
-        }
-      else
-        {
-          i_d = (i + count - int((m_offset / 180 * M_PI) / incr)) % count;
-        }
-      m_range.ranges[i] = scan.ranges[i_d] * m_scale;
-//      if (m_debug == 1 && i % 15 < 5)
-//        {
-//          if (i % 15 == 0) { std::cout << std::setw(4) << i << ": "; }
-//          std::cout << std::setw(5) << scan.ranges[i_d] * m_scale;
-//          std::cout << " [" << std::setw(3) << i_d << "] ";
-//          if (i % 5 == 4) { std::cout << std::endl; }
-//        }
-      if (m_debug == 1 && i % 45 == 0)
-        {
-          double len = m_range.ranges[i];
-          std::cout << std::setw(5) << i << ": ";
-          size_t out_len = std::min(len * 100, 60.0);
-          for (size_t g = 0; g < size_t(out_len); ++g)
-            {
-              std::cout << "|";
-            }
-          std::cout << " " << int(len * 100) << "[cm]" << std::endl;
-        }
-    }
-    if (m_debug == 1) { std::cout << std::endl; }
-
-    m_rangeOut.write();
-    return RTC::RTC_OK;
-}
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onAborting(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onError(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-
-RTC::ReturnCode_t RobotisLDSensor::onReset(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onStateUpdate(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-/*
-RTC::ReturnCode_t RobotisLDSensor::onRateChanged(RTC::UniqueId ec_id)
-{
-  return RTC::RTC_OK;
-}
-*/
-
-
-
-extern "C"
-{
-
-  void RobotisLDSensorInit(RTC::Manager* manager)
-  {
-    coil::Properties profile(robotisldsensor_spec);
-    manager->registerFactory(profile,
-                             RTC::Create<RobotisLDSensor>,
-                             RTC::Delete<RobotisLDSensor>);
-  }
-
-};
-
-
+﻿// -*- C++ -*-
+/*!
+ * @file  RobotisLDSensor.cpp
+ * @brief Robotis LDS-01 RTC
+ * @date $Date$
+ *
+ * $Id$
+ */
+
+#include "RobotisLDSensor.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+// Parameters each precomputed plan is derived from
+static const char* const rotation_params[] = { "offset", "scale", NULL };
+static const char* const filter_params[] = {
+  "filter_min_intensity", "filter_median", "filter_shadow_angle",
+  "filter_shadow_window", "filter_speckle_distance", "scale", NULL
+};
+static const char* const mount_params[] = {
+  "geometry_x", "geometry_y", "geometry_z",
+  "geometry_roll", "geometry_pitch", "geometry_yaw", NULL
+};
+static const char* const bin_params[] = {
+  "bin0_width", "bin0_mode", "bin1_width", "bin1_mode", NULL
+};
+static const char* const grid_params[] = {
+  "grid_size", "grid_resolution", NULL
+};
+static const char* const matcher_params[] = {
+  "odometry_max_distance", "odometry_iterations", NULL
+};
+// In RobotisLDSensor::PublishPort order
+static const char* const publish_params[] = {
+  "publish_range", "publish_sector", "publish_beam_time",
+  "publish_point_cloud", "publish_range_bin0", "publish_range_bin1",
+  "publish_grid", "publish_odometry", "publish_compact", NULL
+};
+
+// Module specification
+// <rtc-template block="module_spec">
+static const char* robotisldsensor_spec[] =
+  {
+    "implementation_id", "RobotisLDSensor",
+    "type_name",         "RobotisLDSensor",
+    "description",       "Robotis LDS-01 RTC",
+    "version",           "1.0.0",
+    "vendor",            "aist",
+    "category",          "Sensor",
+    "activity_type",     "PERIODIC",
+    "kind",              "DataFlowComponent",
+    "max_instance",      "4",
+    "language",          "C++",
+    "lang_type",         "compile",
+    // Configuration variables
+    "conf.default.port_name", "/dev/ttyUSB0",
+    "conf.default.baudrate", "230400",
+    "conf.default.debug", "0",
+    "conf.default.scale", "1.0",
+    "conf.default.offset", "5.0",
+    "conf.default.geometry_x", "0.0",
+    "conf.default.geometry_y", "0.0",
+    "conf.default.geometry_z", "0.0",
+    "conf.default.sector_output", "0",
+    "conf.default.verify_checksum", "1",
+    "conf.default.capture_file", "",
+    "conf.default.replay_speed", "1.0",
+    "conf.default.serial_raw", "1",
+    "conf.default.serial_vmin", "1",
+    "conf.default.serial_vtime", "0",
+    "conf.default.serial_low_latency", "1",
+    "conf.default.serial_rx_buffer", "0",
+    "conf.default.serial_tx_buffer", "0",
+    "conf.default.filter_min_intensity", "0.0",
+    "conf.default.filter_median", "0",
+    "conf.default.filter_shadow_angle", "0.0",
+    "conf.default.filter_shadow_window", "1",
+    "conf.default.filter_speckle_distance", "0.0",
+    "conf.default.geometry_roll", "0.0",
+    "conf.default.geometry_pitch", "0.0",
+    "conf.default.geometry_yaw", "0.0",
+    "conf.default.point_cloud_output", "0",
+    "conf.default.bin0_width", "0",
+    "conf.default.bin0_mode", "min",
+    "conf.default.bin1_width", "0",
+    "conf.default.bin1_mode", "min",
+    "conf.default.grid_output", "0",
+    "conf.default.grid_size", "160",
+    "conf.default.grid_resolution", "0.05",
+    "conf.default.odometry_output", "0",
+    "conf.default.odometry_max_distance", "0.3",
+    "conf.default.odometry_iterations", "20",
+    "conf.default.compact_output", "0",
+    "conf.default.compact_encoding", "delta",
+    "conf.default.compact_key_interval", "10",
+    "conf.default.compact_intensities", "0",
+    "conf.default.shared_output", "0",
+    "conf.default.shared_name", "",
+    "conf.default.shared_slots", "4",
+    "conf.default.publish_range", "all",
+    "conf.default.publish_sector", "all",
+    "conf.default.publish_beam_time", "all",
+    "conf.default.publish_point_cloud", "all",
+    "conf.default.publish_range_bin0", "all",
+    "conf.default.publish_range_bin1", "all",
+    "conf.default.publish_grid", "all",
+    "conf.default.publish_odometry", "all",
+    "conf.default.publish_compact", "all",
+
+    // Widget
+    "conf.__widget__.port_name", "text",
+    "conf.__widget__.baudrate", "text",
+    "conf.__widget__.debug", "radio",
+    "conf.__widget__.scale", "slider.0.001",
+    "conf.__widget__.offset", "slider",
+    "conf.__widget__.geometry_x", "text",
+    "conf.__widget__.geometry_y", "text",
+    "conf.__widget__.geometry_z", "text",
+    "conf.__widget__.sector_output", "radio",
+    "conf.__widget__.verify_checksum", "radio",
+    "conf.__widget__.capture_file", "text",
+    "conf.__widget__.replay_speed", "text",
+    "conf.__widget__.serial_raw", "radio",
+    "conf.__widget__.serial_vmin", "text",
+    "conf.__widget__.serial_vtime", "text",
+    "conf.__widget__.serial_low_latency", "radio",
+    "conf.__widget__.serial_rx_buffer", "text",
+    "conf.__widget__.serial_tx_buffer", "text",
+    "conf.__widget__.filter_min_intensity", "text",
+    "conf.__widget__.filter_median", "radio",
+    "conf.__widget__.filter_shadow_angle", "text",
+    "conf.__widget__.filter_shadow_window", "text",
+    "conf.__widget__.filter_speckle_distance", "text",
+    "conf.__widget__.geometry_roll", "text",
+    "conf.__widget__.geometry_pitch", "text",
+    "conf.__widget__.geometry_yaw", "text",
+    "conf.__widget__.point_cloud_output", "radio",
+    "conf.__widget__.bin0_width", "text",
+    "conf.__widget__.bin0_mode", "radio",
+    "conf.__widget__.bin1_width", "text",
+    "conf.__widget__.bin1_mode", "radio",
+    "conf.__widget__.grid_output", "radio",
+    "conf.__widget__.grid_size", "text",
+    "conf.__widget__.grid_resolution", "text",
+    "conf.__widget__.odometry_output", "radio",
+    "conf.__widget__.odometry_max_distance", "text",
+    "conf.__widget__.odometry_iterations", "text",
+    "conf.__widget__.compact_output", "radio",
+    "conf.__widget__.compact_encoding", "radio",
+    "conf.__widget__.compact_key_interval", "text",
+    "conf.__widget__.compact_intensities", "radio",
+    "conf.__widget__.shared_output", "radio",
+    "conf.__widget__.shared_name", "text",
+    "conf.__widget__.shared_slots", "text",
+    "conf.__widget__.publish_range", "text",
+    "conf.__widget__.publish_sector", "text",
+    "conf.__widget__.publish_beam_time", "text",
+    "conf.__widget__.publish_point_cloud", "text",
+    "conf.__widget__.publish_range_bin0", "text",
+    "conf.__widget__.publish_range_bin1", "text",
+    "conf.__widget__.publish_grid", "text",
+    "conf.__widget__.publish_odometry", "text",
+    "conf.__widget__.publish_compact", "text",
+    // Constraints
+    "conf.__constraints__.debug", "(0, 1)",
+    "conf.__constraints__.scale", "0.001<x<1000.0",
+    "conf.__constraints__.offset", "-180.0<x<180.0",
+    "conf.__constraints__.sector_output", "(0, 1)",
+    "conf.__constraints__.verify_checksum", "(0, 1)",
+    "conf.__constraints__.replay_speed", "0.0<=x",
+    "conf.__constraints__.serial_raw", "(0, 1)",
+    "conf.__constraints__.serial_vmin", "0<=x<=255",
+    "conf.__constraints__.serial_vtime", "0<=x<=255",
+    "conf.__constraints__.serial_low_latency", "(0, 1)",
+    "conf.__constraints__.serial_rx_buffer", "0<=x",
+    "conf.__constraints__.serial_tx_buffer", "0<=x",
+    "conf.__constraints__.filter_min_intensity", "0.0<=x",
+    "conf.__constraints__.filter_median", "(0, 3, 5)",
+    "conf.__constraints__.filter_shadow_angle", "0.0<=x<90.0",
+    "conf.__constraints__.filter_shadow_window", "1<=x<=10",
+    "conf.__constraints__.filter_speckle_distance", "0.0<=x",
+    "conf.__constraints__.geometry_roll", "-180.0<=x<=180.0",
+    "conf.__constraints__.geometry_pitch", "-180.0<=x<=180.0",
+    "conf.__constraints__.geometry_yaw", "-180.0<=x<=180.0",
+    "conf.__constraints__.point_cloud_output", "(0, 1)",
+    "conf.__constraints__.bin0_width", "0<=x<=30",
+    "conf.__constraints__.bin0_mode", "(min, mean, nearest)",
+    "conf.__constraints__.bin1_width", "0<=x<=30",
+    "conf.__constraints__.bin1_mode", "(min, mean, nearest)",
+    "conf.__constraints__.grid_output", "(0, 1)",
+    "conf.__constraints__.grid_size", "3<=x<=1024",
+    "conf.__constraints__.grid_resolution", "0.0<x",
+    "conf.__constraints__.odometry_output", "(0, 1)",
+    "conf.__constraints__.odometry_max_distance", "0.0<x",
+    "conf.__constraints__.odometry_iterations", "1<=x<=100",
+    "conf.__constraints__.compact_output", "(0, 1)",
+    "conf.__constraints__.compact_encoding", "(raw, delta)",
+    "conf.__constraints__.compact_key_interval", "1<=x<=1000",
+    "conf.__constraints__.compact_intensities", "(0, 1)",
+    "conf.__constraints__.shared_output", "(0, 1)",
+    "conf.__constraints__.shared_slots", "2<=x<=64",
+
+    "conf.__type__.port_name", "string",
+    "conf.__type__.baudrate", "int",
+    "conf.__type__.debug", "int",
+    "conf.__type__.scale", "float",
+    "conf.__type__.offset", "double",
+    "conf.__type__.geometry_x", "double",
+    "conf.__type__.geometry_y", "double",
+    "conf.__type__.geometry_z", "double",
+    "conf.__type__.sector_output", "int",
+    "conf.__type__.verify_checksum", "int",
+    "conf.__type__.capture_file", "string",
+    "conf.__type__.replay_speed", "double",
+    "conf.__type__.serial_raw", "int",
+    "conf.__type__.serial_vmin", "int",
+    "conf.__type__.serial_vtime", "int",
+    "conf.__type__.serial_low_latency", "int",
+    "conf.__type__.serial_rx_buffer", "int",
+    "conf.__type__.serial_tx_buffer", "int",
+    "conf.__type__.filter_min_intensity", "double",
+    "conf.__type__.filter_median", "int",
+    "conf.__type__.filter_shadow_angle", "double",
+    "conf.__type__.filter_shadow_window", "int",
+    "conf.__type__.filter_speckle_distance", "double",
+    "conf.__type__.geometry_roll", "double",
+    "conf.__type__.geometry_pitch", "double",
+    "conf.__type__.geometry_yaw", "double",
+    "conf.__type__.point_cloud_output", "int",
+    "conf.__type__.bin0_width", "int",
+    "conf.__type__.bin0_mode", "string",
+    "conf.__type__.bin1_width", "int",
+    "conf.__type__.bin1_mode", "string",
+    "conf.__type__.grid_output", "int",
+    "conf.__type__.grid_size", "int",
+    "conf.__type__.grid_resolution", "double",
+    "conf.__type__.odometry_output", "int",
+    "conf.__type__.odometry_max_distance", "double",
+    "conf.__type__.odometry_iterations", "int",
+    "conf.__type__.compact_output", "int",
+    "conf.__type__.compact_encoding", "string",
+    "conf.__type__.compact_key_interval", "int",
+    "conf.__type__.compact_intensities", "int",
+    "conf.__type__.shared_output", "int",
+    "conf.__type__.shared_name", "string",
+    "conf.__type__.shared_slots", "int",
+    "conf.__type__.publish_range", "string",
+    "conf.__type__.publish_sector", "string",
+    "conf.__type__.publish_beam_time", "string",
+    "conf.__type__.publish_point_cloud", "string",
+    "conf.__type__.publish_range_bin0", "string",
+    "conf.__type__.publish_range_bin1", "string",
+    "conf.__type__.publish_grid", "string",
+    "conf.__type__.publish_odometry", "string",
+    "conf.__type__.publish_compact", "string",
+
+    ""
+  };
+// </rtc-template>
+
+/*!
+ * @brief constructor
+ * @param manager Maneger Object
+ */
+RobotisLDSensor::RobotisLDSensor(RTC::Manager* manager)
+    // <rtc-template block="initializer">
+  : RTC::DataFlowComponentBase(manager),
+    m_rangeOut("range", m_range),
+    m_sectorOut("sector", m_sector),
+    m_beamTimeOut("beam_time", m_beamTime),
+    m_pointCloudOut("point_cloud", m_pointCloud),
+    m_rangeBin0Out("range_bin0", m_rangeBin0),
+    m_rangeBin1Out("range_bin1", m_rangeBin1),
+    m_gridOut("grid", m_grid),
+    m_odometryOut("odometry", m_odometry),
+    m_compactOut("compact", m_compact)
+
+    // </rtc-template>
+    , m_planDirty(true), m_filterDirty(true), m_metresValid(false),
+      m_mountDirty(true), m_binDirty(true), m_gridDirty(true),
+      m_matcherDirty(true), m_sharedFailed(false), m_publishDirty(true)
+{
+}
+
+/*!
+ * @brief destructor
+ */
+RobotisLDSensor::~RobotisLDSensor()
+{
+}
+
+
+
+RTC::ReturnCode_t RobotisLDSensor::onInitialize()
+{
+  // Registration: InPort/OutPort/Service
+  // <rtc-template block="registration">
+  // Set InPort buffers
+
+  // Set OutPort buffer
+  addOutPort("range", m_rangeOut);
+  addOutPort("sector", m_sectorOut);
+  addOutPort("beam_time", m_beamTimeOut);
+  addOutPort("point_cloud", m_pointCloudOut);
+  addOutPort("range_bin0", m_rangeBin0Out);
+  addOutPort("range_bin1", m_rangeBin1Out);
+  addOutPort("grid", m_gridOut);
+  addOutPort("odometry", m_odometryOut);
+  addOutPort("compact", m_compactOut);
+
+  // Set service provider to Ports
+
+  // Set service consumers to Ports
+
+  // Set CORBA Service Ports
+
+  // </rtc-template>
+
+  // <rtc-template block="bind_config">
+  // Bind variables and configuration variable
+  bindParameter("port_name", m_port_name, "/dev/ttyUSB0");
+  bindParameter("baudrate", m_baudrate, "230400");
+  bindParameter("debug", m_debug, "0");
+  bindParameter("scale", m_scale, "1.0");
+  bindParameter("offset", m_offset, "5.0");
+  bindParameter("geometry_x", m_geometry_x, "0.0");
+  bindParameter("geometry_y", m_geometry_y, "0.0");
+  bindParameter("geometry_z", m_geometry_z, "0.0");
+  bindParameter("sector_output", m_sector_output, "0");
+  bindParameter("verify_checksum", m_verify_checksum, "1");
+  bindParameter("capture_file", m_capture_file, "");
+  bindParameter("replay_speed", m_replay_speed, "1.0");
+  bindParameter("serial_raw", m_serial_raw, "1");
+  bindParameter("serial_vmin", m_serial_vmin, "1");
+  bindParameter("serial_vtime", m_serial_vtime, "0");
+  bindParameter("serial_low_latency", m_serial_low_latency, "1");
+  bindParameter("serial_rx_buffer", m_serial_rx_buffer, "0");
+  bindParameter("serial_tx_buffer", m_serial_tx_buffer, "0");
+  bindParameter("filter_min_intensity", m_filter_min_intensity, "0.0");
+  bindParameter("filter_median", m_filter_median, "0");
+  bindParameter("filter_shadow_angle", m_filter_shadow_angle, "0.0");
+  bindParameter("filter_shadow_window", m_filter_shadow_window, "1");
+  bindParameter("filter_speckle_distance", m_filter_speckle_distance, "0.0");
+  bindParameter("geometry_roll", m_geometry_roll, "0.0");
+  bindParameter("geometry_pitch", m_geometry_pitch, "0.0");
+  bindParameter("geometry_yaw", m_geometry_yaw, "0.0");
+  bindParameter("point_cloud_output", m_point_cloud_output, "0");
+  bindParameter("bin0_width", m_bin0_width, "0");
+  bindParameter("bin0_mode", m_bin0_mode, "min");
+  bindParameter("bin1_width", m_bin1_width, "0");
+  bindParameter("bin1_mode", m_bin1_mode, "min");
+  bindParameter("grid_output", m_grid_output, "0");
+  bindParameter("grid_size", m_grid_size, "160");
+  bindParameter("grid_resolution", m_grid_resolution, "0.05");
+  bindParameter("odometry_output", m_odometry_output, "0");
+  bindParameter("odometry_max_distance", m_odometry_max_distance, "0.3");
+  bindParameter("odometry_iterations", m_odometry_iterations, "20");
+  bindParameter("compact_output", m_compact_output, "0");
+  bindParameter("compact_encoding", m_compact_encoding, "delta");
+  bindParameter("compact_key_interval", m_compact_key_interval, "10");
+  bindParameter("compact_intensities", m_compact_intensities, "0");
+  bindParameter("shared_output", m_shared_output, "0");
+  bindParameter("shared_name", m_shared_name, "");
+  bindParameter("shared_slots", m_shared_slots, "4");
+  bindParameter("publish_range", m_publish_range, "all");
+  bindParameter("publish_sector", m_publish_sector, "all");
+  bindParameter("publish_beam_time", m_publish_beam_time, "all");
+  bindParameter("publish_point_cloud", m_publish_point_cloud, "all");
+  bindParameter("publish_range_bin0", m_publish_range_bin0, "all");
+  bindParameter("publish_range_bin1", m_publish_range_bin1, "all");
+  bindParameter("publish_grid", m_publish_grid, "all");
+  bindParameter("publish_odometry", m_publish_odometry, "all");
+  bindParameter("publish_compact", m_publish_compact, "all");
+  // </rtc-template>
+
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_planDirty,
+                                                 rotation_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_filterDirty,
+                                                 filter_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_mountDirty,
+                                                 mount_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_binDirty, bin_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_gridDirty, grid_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_matcherDirty,
+                                                 matcher_params));
+  addConfigurationParamListener(RTC::ON_UPDATE_CONFIG_PARAM,
+                                new PlanListener(m_publishDirty,
+                                                 publish_params));
+
+  return RTC::RTC_OK;
+}
+
+RTC::ReturnCode_t RobotisLDSensor::onFinalize()
+{
+  // Readers still mapping the ring keep it until they unmap
+  if (!m_sharedWriter.name().empty())
+    {
+      HLDS::SharedScanWriter::unlink(m_sharedWriter.name());
+    }
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onStartup(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onShutdown(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+RTC::ReturnCode_t RobotisLDSensor::onActivated(RTC::UniqueId ec_id)
+{
+    RTC_DEBUG(("onActivated()"));
+    try
+    {
+        HLDS::SerialOptions serial;
+        serial.raw = m_serial_raw == 1;
+        serial.vmin = uint8_t(m_serial_vmin);
+        serial.vtime = uint8_t(m_serial_vtime);
+        serial.lowLatency = m_serial_low_latency == 1;
+        serial.rxBufferSize = uint32_t(m_serial_rx_buffer);
+        serial.txBufferSize = uint32_t(m_serial_tx_buffer);
+        // port_name "replay:<file>" replays a capture instead of the device
+        HLDS::ByteSource* source =
+          HLDS::openByteSource(m_port_name, m_baudrate, m_replay_speed,
+                               serial);
+        if (!m_capture_file.empty())
+          {
+            source = new HLDS::RecordingSource(source, m_capture_file,
+                                               m_baudrate);
+            RTC_INFO(("Recording to %s", m_capture_file.c_str()));
+          }
+        m_ldsensor = new HLDS::LDSensor(source);
+    }
+    catch (const std::exception& e)
+    {
+        RTC_DEBUG(("LDSensor device open failed: %s", e.what()));
+        RTC_DEBUG(("Port name: %s", m_port_name));
+        RTC_DEBUG(("Baud rate: %d", m_baudrate));
+        return RTC::RTC_ERROR; 
+    }
+    RTC_INFO(("LDSensor opened: %s, %d", m_port_name, m_baudrate));
+    RTC_INFO(("Serial raw: %d (vmin %d, vtime %d), low latency: %d",
+              m_serial_raw, m_serial_vmin, m_serial_vtime,
+              m_serial_low_latency));
+#if !defined(_WIN32)
+    if (m_serial_rx_buffer != 0 || m_serial_tx_buffer != 0)
+      {
+        RTC_WARN(("serial_rx_buffer and serial_tx_buffer only apply on "
+                  "Windows, ignored"));
+      }
+#endif
+    RTC_INFO(("Frame decoding kernel: %s", HLDS::decodeKernel()));
+    RTC_INFO(("Scan filter kernel: %s", HLDS::filterKernel()));
+    RTC_INFO(("Point conversion kernel: %s", HLDS::pointKernel()));
+    m_ldsensor->setChecksumCheck(m_verify_checksum == 1);
+    updateRotationPlan();
+    updateFilterPlan();
+    m_handoffLatency.reset();
+    m_decodeLatency.reset();
+    m_filterLatency.reset();
+    m_pointLatency.reset();
+    m_binLatency.reset();
+    m_gridLatency.reset();
+    m_odometryLatency.reset();
+    m_compactLatency.reset();
+    m_sharedLatency.reset();
+    m_publishLatency.reset();
+    m_totalLatency.reset();
+    m_ldsensor->startAcquisition();
+
+    float incr = 2.0 * M_PI / HLDS::BeamCount;
+    // https://emanual.robotis.com/assets/docs/LDS_Basic_Specification.pdf
+    m_range.config.minAngle = 0.0;
+    m_range.config.maxAngle = 2.0 * M_PI - incr;
+    // spec: angular resolution = 1 degree
+    m_range.config.angularRes = incr;
+    m_range.config.minRange = 120 / 1000.0;
+    m_range.config.maxRange = 3500 / 1000.0;
+    m_range.config.rangeRes = 15 / 1000.0; // 15mm (12mm-499mm)
+    m_range.config.frequency = 0.0;
+    updateMount();
+    updateBinPlans();
+    updateGrid();
+    updateMatcher();
+    updatePublishPolicies();
+    for (size_t i = 0; i < PublishPortCount; ++i)
+      {
+        m_publishGate[i].resetStats();
+      }
+    // Sized once, shorter revolutions keep the buffer
+    m_pointCloud.points.length(HLDS::BeamCount);
+
+    m_ldsensor->setSectorStreaming(m_sector_output == 1);
+    return RTC::RTC_OK;
+}
+
+
+RTC::ReturnCode_t RobotisLDSensor::onDeactivated(RTC::UniqueId ec_id)
+{
+    m_ldsensor->stopAcquisition();
+    RTC_DEBUG(("LDSensor acquisition thread stopped."));
+    HLDS::FramerStats stats(m_ldsensor->stats());
+    RTC_INFO(("Serial reads: %llu, %llu bytes (%.1f bytes/read)",
+              (unsigned long long)stats.reads,
+              (unsigned long long)stats.bytes, stats.bytesPerRead()));
+    RTC_INFO(("Frames: %llu, discarded bytes: %llu, resyncs: %llu",
+              (unsigned long long)stats.frames,
+              (unsigned long long)stats.discarded,
+              (unsigned long long)stats.resyncs));
+    RTC_INFO(("Dropped sectors: %llu",
+              (unsigned long long)m_ldsensor->droppedSectors()));
+    HLDS::PacketStats packets(m_ldsensor->packetStats());
+    RTC_INFO(("Packets: %llu good, %llu bad checksum",
+              (unsigned long long)packets.good,
+              (unsigned long long)packets.badChecksum));
+    std::vector<std::string> latency(latencyReport());
+    for (size_t i = 0; i < latency.size(); ++i)
+      {
+        RTC_INFO(("%s", latency[i].c_str()));
+      }
+    for (size_t i = 0; i < PublishPortCount; ++i)
+      {
+        const HLDS::PublishStats& s(m_publishGate[i].stats());
+        if (s.offered() == 0) { continue; }
+        // Port name after "publish_"
+        RTC_INFO(("Port %s: %llu published, %llu dropped, %llu coalesced",
+                  publish_params[i] + 8, (unsigned long long)s.published,
+                  (unsigned long long)s.dropped,
+                  (unsigned long long)s.coalesced));
+      }
+    m_ldsensor->stopMotor();
+    RTC_DEBUG(("LDSensor motor stopped."));
+    m_ldsensor->close();
+    RTC_DEBUG(("LDSensor device closed."));
+    m_sharedWriter.close();
+    m_sharedFailed = false;
+    delete m_ldsensor;
+    RTC_PARANOID(("LDSensor object deleted."));
+    return RTC::RTC_OK;
+}
+
+
+RTC::ReturnCode_t RobotisLDSensor::onExecute(RTC::UniqueId ec_id)
+{
+    size_t count = HLDS::BeamCount;
+    if (m_planDirty.exchange(false)) { updateRotationPlan(); }
+    if (m_filterDirty.exchange(false)) { updateFilterPlan(); }
+    if (m_mountDirty.exchange(false)) { updateMount(); }
+    if (m_binDirty.exchange(false)) { updateBinPlans(); }
+    if (m_gridDirty.exchange(false)) { updateGrid(); }
+    if (m_matcherDirty.exchange(false)) { updateMatcher(); }
+    if (m_publishDirty.exchange(false)) { updatePublishPolicies(); }
+
+    m_ldsensor->setChecksumCheck(m_verify_checksum == 1);
+    // Packets are published as they arrive, ahead of the revolution
+    m_ldsensor->setSectorStreaming(m_sector_output == 1);
+    HLDS::Sector sector;
+    while (m_ldsensor->nextSector(sector))
+      {
+        if (admit(PublishSector, m_sectorOut)) { writeSector(sector); }
+      }
+
+    // The acquisition thread reads frames in the background, so this
+    // never blocks the execution context.
+    const HLDS::RawFrame* frame = m_ldsensor->latestFrame();
+    if (frame == NULL)
+      {
+        if (m_ldsensor->failed())
+          {
+            RTC_ERROR(("LDSensor acquisition failed."));
+            return RTC::RTC_ERROR;
+          }
+        return RTC::RTC_OK;
+      }
+    uint64_t picked = HLDS::monotonicNow();
+    m_handoffLatency.record(picked - frame->completeTime);
+
+    // Time stamp of the first beam, the beam_time port gives the offset
+    // of every range from it
+    HLDS::ScanTiming timing = HLDS::scanTiming(*frame);
+    m_range.tm.sec = CORBA::ULong(timing.wallStart / 1000000000);
+    m_range.tm.nsec = CORBA::ULong(timing.wallStart % 1000000000);
+    // spec: 300+-10rpm, revolutions per second from the estimated period
+    m_range.config.frequency = frame->period != 0 ? 1e9 / frame->period : 0.0;
+
+    if (m_debug == 1)
+      {
+        double min_angle = m_range.config.minAngle;
+        double max_angle = m_range.config.maxAngle;
+        std::cout << "min angle: " << min_angle << std::endl;
+        std::cout << "min angle: " << min_angle * 180 / M_PI << " [deg]" << std::endl;
+        std::cout << "max angle: " << max_angle << std::endl;
+        std::cout << "max angle: " << max_angle * 180 / M_PI << " [deg]" << std::endl;
+        double incr = m_range.config.angularRes;
+        std::cout << "angle res: " << incr << std::endl;
+        std::cout << "angle res: " << incr * 180 / M_PI << " [deg]" << std::endl;
+        std::cout << "min range: " << m_range.config.minRange << " [m]"<< std::endl;
+        std::cout << "max range: " << m_range.config.maxRange << " [m]" << std::endl;
+        std::cout << "range res: " << m_range.config.rangeRes << " [m]" << std::endl;
+        std::cout << "freq:      " << m_ldsensor->rpm() << " [rpm]" << std::endl;
+        std::cout << "freq:      " << m_range.config.frequency << " [Hz]" << std::endl;
+        std::cout << "range num: " << count << std::endl; 
+        HLDS::FramerStats stats(m_ldsensor->stats());
+        std::cout << "reads:     " << stats.reads << " (";
+        std::cout << stats.bytesPerRead() << " [bytes/read])" << std::endl;
+        HLDS::PacketStats packets(m_ldsensor->packetStats());
+        std::cout << "packets:   " << packets.good << " good, ";
+        std::cout << packets.badChecksum << " bad checksum, ";
+        std::cout << stats.discarded << " discarded bytes, ";
+        std::cout << stats.resyncs << " resyncs" << std::endl;
+        std::vector<std::string> latency(latencyReport());
+        for (size_t i = 0; i < latency.size(); ++i)
+          {
+            std::cout << latency[i] << std::endl;
+          }
+      }
+
+    // Decode the frame straight into the OutPort buffer, scaled and
+    // rotated by the angular offset.
+    uint64_t decode_start = HLDS::monotonicNow();
+    m_range.ranges.length(count);
+    HLDS::ScanSpan<CORBA::Double> out;
+    out.ranges = m_range.ranges.get_buffer();
+    // Intensities are only decoded when the intensity filter, the
+    // compact port or the shared memory ring needs them
+    bool intensities = m_filterPlan.minIntensity > 0.0 ||
+      (m_compact_output == 1 && m_compact_intensities == 1) ||
+      m_shared_output == 1;
+    out.intensities = intensities ? m_intensities : NULL;
+    out.scale = m_plan.scale;
+    out.shift = m_plan.shift;
+    HLDS::decodeFrame(*frame, out);
+    m_metresValid = false;
+    m_decodeLatency.record(HLDS::monotonicNow() - decode_start);
+
+    // Filters run in place on the OutPort buffer, sectors are published
+    // unfiltered
+    if (HLDS::filtersEnabled(m_filterPlan))
+      {
+        uint64_t filter_start = HLDS::monotonicNow();
+        HLDS::filterScan(m_filterPlan, out.ranges, out.intensities);
+        m_filterLatency.record(HLDS::monotonicNow() - filter_start);
+      }
+
+    if (m_debug == 1)
+      {
+        for (size_t i = 0; i < count; i += 45)
+          {
+            double len = m_range.ranges[i];
+            std::cout << std::setw(5) << i << ": ";
+            size_t out_len = std::min(len * 100, 60.0);
+            for (size_t g = 0; g < size_t(out_len); ++g)
+              {
+                std::cout << "|";
+              }
+            std::cout << " " << int(len * 100) << "[cm]" << std::endl;
+          }
+        std::cout << std::endl;
+      }
+
+    // Local consumers first, the ring costs a copy where the OutPort
+    // marshals
+    if (m_shared_output == 1)
+      {
+        uint64_t shared_start = HLDS::monotonicNow();
+        writeShared(out.intensities);
+        m_sharedLatency.record(HLDS::monotonicNow() - shared_start);
+      }
+
+    // The revolution is decoded regardless, the ports below derive
+    // from it. Each port decides before doing any work of its own.
+    if (admit(PublishRange, m_rangeOut))
+      {
+        uint64_t publish_start = HLDS::monotonicNow();
+        m_rangeOut.write();
+        uint64_t published = HLDS::monotonicNow();
+        m_publishLatency.record(published - publish_start);
+        m_totalLatency.record(published - frame->completeTime);
+      }
+
+    if (admit(PublishBeamTime, m_beamTimeOut))
+      {
+        m_beamTime.tm = m_range.tm;
+        m_beamTime.data.length(count);
+        HLDS::beamTimes(timing, m_beamTime.data.get_buffer(), m_plan.shift);
+        m_beamTimeOut.write();
+      }
+
+    if (m_point_cloud_output == 1 &&
+        admit(PublishPointCloud, m_pointCloudOut))
+      {
+        uint64_t point_start = HLDS::monotonicNow();
+        writePointCloud();
+        m_pointLatency.record(HLDS::monotonicNow() - point_start);
+      }
+
+    // Decimated scans from the same buffer, after the full scan is out
+    bool bin0 = HLDS::binningEnabled(m_binPlan[0]) &&
+      admit(PublishRangeBin0, m_rangeBin0Out);
+    bool bin1 = HLDS::binningEnabled(m_binPlan[1]) &&
+      admit(PublishRangeBin1, m_rangeBin1Out);
+    if (bin0 || bin1)
+      {
+        uint64_t bin_start = HLDS::monotonicNow();
+        if (bin0) { writeBinned(m_binPlan[0], m_rangeBin0, m_rangeBin0Out); }
+        if (bin1) { writeBinned(m_binPlan[1], m_rangeBin1, m_rangeBin1Out); }
+        m_binLatency.record(HLDS::monotonicNow() - bin_start);
+      }
+
+    // The grid integrates every revolution, only the image is published
+    // by policy
+    if (m_grid_output == 1)
+      {
+        uint64_t grid_start = HLDS::monotonicNow();
+        m_occupancy.update(metres());
+        bool image = admit(PublishGrid, m_gridOut);
+        if (image)
+          {
+            memcpy(m_grid.pixels.get_buffer(), m_occupancy.image(),
+                   m_grid.pixels.length());
+            m_grid.tm = m_range.tm;
+          }
+        m_gridLatency.record(HLDS::monotonicNow() - grid_start);
+        if (image) { m_gridOut.write(); }
+      }
+
+    // Revolutions held back are not matched, the next published motion is
+    // the one since the last published revolution
+    if (m_odometry_output == 1)
+      {
+        if (admit(PublishOdometry, m_odometryOut))
+          {
+            uint64_t odometry_start = HLDS::monotonicNow();
+            writeOdometry();
+            m_odometryLatency.record(HLDS::monotonicNow() - odometry_start);
+          }
+      }
+    else
+      {
+        // A stale revolution is no reference once matching is resumed
+        m_matcher.reset();
+      }
+
+    // Likewise the next coded scan refers to the last published one
+    if (m_compact_output == 1 && admit(PublishCompact, m_compactOut))
+      {
+        uint64_t compact_start = HLDS::monotonicNow();
+        writeCompact(m_compact_intensities == 1 ? out.intensities : NULL);
+        m_compactLatency.record(HLDS::monotonicNow() - compact_start);
+      }
+    return RTC::RTC_OK;
+}
+
+void RobotisLDSensor::writeSector(const HLDS::Sector& sector)
+{
+    // Packet n holds beams 354 - 6n to 359 - 6n, the sector is published
+    // in ascending angle order and may cross the zero direction.
+    double incr = 2.0 * M_PI / HLDS::BeamCount;
+    size_t first = (HLDS::BeamCount - HLDS::BeamsPerPacket * (sector.index + 1)
+                    + m_plan.shift) % HLDS::BeamCount;
+    m_sector.config = m_range.config;
+    m_sector.config.minAngle = first * incr;
+    m_sector.config.maxAngle = (first + HLDS::BeamsPerPacket - 1) * incr;
+    m_sector.config.angularRes = incr;
+    m_sector.ranges.length(HLDS::BeamsPerPacket);
+    HLDS::decodeSector<CORBA::Double>(sector, m_sector.ranges.get_buffer(),
+                                      NULL, m_plan.scale);
+    m_sectorOut.write();
+}
+
+const double* RobotisLDSensor::metres()
+{
+  const CORBA::Double* ranges = m_range.ranges.get_buffer();
+  if (m_plan.scale == 1.0) { return ranges; }
+  if (!m_metresValid)
+    {
+      for (size_t i = 0; i < HLDS::BeamCount; ++i)
+        {
+          m_metres[i] = ranges[i] / m_plan.scale;
+        }
+      m_metresValid = true;
+    }
+  return m_metres;
+}
+
+void RobotisLDSensor::writePointCloud()
+{
+  const double* ranges = metres();
+  HLDS::scanToPoints(m_mount, ranges, m_points);
+  // Beams without a return are left out
+  m_pointCloud.tm = m_range.tm;
+  m_pointCloud.points.length(HLDS::BeamCount);
+  CORBA::ULong n = 0;
+  for (size_t i = 0; i < HLDS::BeamCount; ++i)
+    {
+      if (ranges[i] <= 0.0) { continue; }
+      RTC::PointCloudPoint& p = m_pointCloud.points[n++];
+      p.point.x = m_points.x[i];
+      p.point.y = m_points.y[i];
+      p.point.z = m_points.z[i];
+      p.colour.r = p.colour.g = p.colour.b = 0.0;
+    }
+  m_pointCloud.points.length(n);
+  m_pointCloudOut.write();
+}
+
+void RobotisLDSensor::writeBinned(const HLDS::BinPlan& plan,
+                                  RTC::RangeData& binned,
+                                  RTC::OutPort<RTC::RangeData>& port)
+{
+  if (!HLDS::binningEnabled(plan)) { return; }
+  // The angle of a bin is the angle of its centre
+  double incr = m_range.config.angularRes;
+  binned.tm = m_range.tm;
+  binned.geometry = m_range.geometry;
+  binned.config = m_range.config;
+  binned.config.angularRes = plan.width * incr;
+  binned.config.minAngle = m_range.config.minAngle +
+    (plan.width - 1) / 2.0 * incr;
+  // A narrower last bin is centred on its own beams, which keeps
+  // maxAngle within the revolution
+  size_t last = (plan.bins - 1) * plan.width;
+  size_t last_width = std::min(plan.width, HLDS::BeamCount - last);
+  binned.config.maxAngle = m_range.config.minAngle +
+    (last + (last_width - 1) / 2.0) * incr;
+  binned.ranges.length(plan.bins);
+  HLDS::binScan(plan, m_range.ranges.get_buffer(),
+                binned.ranges.get_buffer());
+  port.write();
+}
+
+void RobotisLDSensor::updateRotationPlan()
+{
+  // The increment stays a float: the shift is truncated exactly as
+  // before the plan was introduced
+  float incr = 2.0 * M_PI / HLDS::BeamCount;
+  m_plan = HLDS::makeRotationPlan(m_offset / 180 * M_PI, incr, m_scale);
+  m_planDirty = false;
+  RTC_DEBUG(("Rotation plan: shift %d beams, scale %f",
+             int(m_plan.shift), m_plan.scale));
+}
+
+void RobotisLDSensor::updateFilterPlan()
+{
+  float incr = 2.0 * M_PI / HLDS::BeamCount;
+  // The filters run on the scaled ranges, the speckle distance is given
+  // in metres
+  m_filterPlan = HLDS::makeScanFilterPlan(m_filter_min_intensity,
+                                          m_filter_median,
+                                          m_filter_shadow_angle / 180 * M_PI,
+                                          m_filter_shadow_window,
+                                          m_filter_speckle_distance * m_scale,
+                                          incr);
+  m_filterDirty = false;
+  RTC_DEBUG(("Scan filters: intensity %f, median %d, shadow %f deg (%d), "
+             "speckle %f m", m_filter_min_intensity, m_filter_median,
+             m_filter_shadow_angle, m_filter_shadow_window,
+             m_filter_speckle_distance));
+}
+
+void RobotisLDSensor::updateMount()
+{
+  double roll = m_geometry_roll / 180 * M_PI;
+  double pitch = m_geometry_pitch / 180 * M_PI;
+  double yaw = m_geometry_yaw / 180 * M_PI;
+  m_mount = HLDS::makeMountTransform(m_geometry_x, m_geometry_y,
+                                     m_geometry_z, roll, pitch, yaw);
+  m_mountDirty = false;
+  m_range.geometry.geometry.pose.position.x = m_geometry_x;
+  m_range.geometry.geometry.pose.position.y = m_geometry_y;
+  m_range.geometry.geometry.pose.position.z = m_geometry_z;
+  m_range.geometry.geometry.pose.orientation.r = roll;
+  m_range.geometry.geometry.pose.orientation.p = pitch;
+  m_range.geometry.geometry.pose.orientation.y = yaw;
+  m_sector.geometry = m_range.geometry;
+  RTC_DEBUG(("Mount: (%f, %f, %f) m, roll %f, pitch %f, yaw %f deg",
+             m_geometry_x, m_geometry_y, m_geometry_z,
+             m_geometry_roll, m_geometry_pitch, m_geometry_yaw));
+}
+
+void RobotisLDSensor::updateBinPlans()
+{
+  const int widths[2] = { m_bin0_width, m_bin1_width };
+  const std::string* modes[2] = { &m_bin0_mode, &m_bin1_mode };
+  for (size_t i = 0; i < 2; ++i)
+    {
+      HLDS::BinMode mode = HLDS::BinMin;
+      if (!HLDS::parseBinMode(*modes[i], mode))
+        {
+          RTC_WARN(("Unknown bin%d_mode: %s, min is used",
+                    int(i), modes[i]->c_str()));
+        }
+      m_binPlan[i] = HLDS::makeBinPlan(std::max(widths[i], 0), mode);
+      RTC_DEBUG(("Binning range_bin%d: %d beams per bin, %d bins",
+                 int(i), int(m_binPlan[i].width), int(m_binPlan[i].bins)));
+    }
+  m_binDirty = false;
+}
+
+void RobotisLDSensor::updateGrid()
+{
+  m_occupancy.configure(std::max(m_grid_size, 3),
+                        std::max(m_grid_resolution, 0.001));
+  m_gridDirty = false;
+  // 8 bit grey image, one pixel per cell, fDiv carries the cell size
+  m_grid.width = CORBA::UShort(m_occupancy.size());
+  m_grid.height = CORBA::UShort(m_occupancy.size());
+  m_grid.bpp = 8;
+  m_grid.format = "";
+  m_grid.fDiv = m_occupancy.resolution();
+  m_grid.pixels.length(m_occupancy.size() * m_occupancy.size());
+  RTC_DEBUG(("Occupancy grid: %d x %d cells of %f m",
+             int(m_occupancy.size()), int(m_occupancy.size()),
+             m_occupancy.resolution()));
+}
+
+void RobotisLDSensor::updateMatcher()
+{
+  m_matcher.configure(m_odometry_max_distance > 0.0 ?
+                      m_odometry_max_distance : 0.3,
+                      std::max(m_odometry_iterations, 1));
+  m_matcherDirty = false;
+  RTC_DEBUG(("Scan matching: %f m, %d iterations",
+             m_odometry_max_distance, m_odometry_iterations));
+}
+
+void RobotisLDSensor::writeOdometry()
+{
+  HLDS::Motion2D motion;
+  if (!m_matcher.match(metres(), motion))
+    {
+      RTC_DEBUG(("Scan matching: no motion, %d pairs",
+                 int(m_matcher.matches())));
+      return;
+    }
+  m_odometry.tm = m_range.tm;
+  m_odometry.data.position.x = motion.x;
+  m_odometry.data.position.y = motion.y;
+  m_odometry.data.heading = motion.heading;
+  m_odometryOut.write();
+}
+
+void RobotisLDSensor::writeCompact(const double* intensities)
+{
+  static_assert(HLDS::CompactScanBeams == HLDS::BeamCount,
+                "a revolution does not fit a compact scan");
+  // Millimetres whatever the scale of the RangeData
+  const size_t count = HLDS::BeamCount;
+  m_compact.tm = m_range.tm;
+  m_compact.minAngle = m_range.config.minAngle;
+  m_compact.angularRes = m_range.config.angularRes;
+  m_compact.beams = CORBA::UShort(count);
+  m_compact.hasIntensities = intensities != NULL;
+  if (m_compact_encoding == "raw")
+    {
+      m_compact.encoding = RobotisLDS::SCAN_RAW;
+      m_compact.seq = m_compactEncoder.rawFrame();
+      m_compact.reference = m_compact.seq;
+      m_compact.ranges.length(count);
+      HLDS::quantiseRanges(metres(), count,
+                           m_compact.ranges.get_buffer());
+      m_compact.intensities.length(intensities != NULL ? count : 0);
+      if (intensities != NULL)
+        {
+          HLDS::quantiseIntensities(intensities, count,
+                                    m_compact.intensities.get_buffer());
+        }
+      m_compact.data.length(0);
+    }
+  else
+    {
+      m_compact.encoding = RobotisLDS::SCAN_DELTA;
+      m_compactEncoder.setKeyFrameInterval(std::max(m_compact_key_interval,
+                                                    1));
+      HLDS::quantiseRanges(metres(), count,
+                           m_compactRanges);
+      if (intensities != NULL)
+        {
+          HLDS::quantiseIntensities(intensities, count,
+                                    m_compactIntensities);
+        }
+      m_compact.ranges.length(0);
+      m_compact.intensities.length(0);
+      m_compact.data.length(2 * HLDS::maxDeltaBytes(count));
+      uint32_t seq, reference;
+      size_t length = m_compactEncoder.encode(
+        m_compactRanges, intensities != NULL ? m_compactIntensities : NULL,
+        m_compact.data.get_buffer(), seq, reference);
+      m_compact.seq = seq;
+      m_compact.reference = reference;
+      m_compact.data.length(length);
+    }
+  m_compactOut.write();
+}
+
+void RobotisLDSensor::writeShared(const double* intensities)
+{
+  static_assert(HLDS::SharedScanBeams == HLDS::BeamCount,
+                "a revolution does not fit a shared scan");
+  if (!m_sharedWriter.isOpen())
+    {
+      if (m_sharedFailed) { return; }
+      try
+        {
+          // One writer per segment, instances sharing a manager get
+          // one each by default
+          std::string name(m_shared_name);
+          if (name.empty()) { name = getInstanceName(); }
+          m_sharedWriter.open(name, size_t(m_shared_slots));
+        }
+      catch (const std::exception& e)
+        {
+          RTC_ERROR(("Shared memory ring not available: %s", e.what()));
+          m_sharedFailed = true;
+          return;
+        }
+      RTC_INFO(("Shared memory ring: %s, %d slots",
+                m_sharedWriter.name().c_str(), m_shared_slots));
+    }
+  size_t count = m_range.ranges.length();
+  HLDS::SharedScan& scan = m_sharedWriter.beginWrite();
+  scan.sec = m_range.tm.sec;
+  scan.nsec = m_range.tm.nsec;
+  scan.minAngle = m_range.config.minAngle;
+  scan.angularRes = m_range.config.angularRes;
+  scan.beams = uint32_t(count);
+  scan.hasIntensities = intensities != NULL;
+  // Metres as documented for readers, whatever the scale of the RangeData
+  memcpy(scan.ranges, metres(), count * sizeof(double));
+  if (intensities != NULL)
+    {
+      memcpy(scan.intensities, intensities, count * sizeof(double));
+    }
+  m_sharedWriter.publish();
+}
+
+void RobotisLDSensor::updatePublishPolicies()
+{
+  const std::string* policies[PublishPortCount] = {
+    &m_publish_range, &m_publish_sector, &m_publish_beam_time,
+    &m_publish_point_cloud, &m_publish_range_bin0, &m_publish_range_bin1,
+    &m_publish_grid, &m_publish_odometry, &m_publish_compact
+  };
+  for (size_t i = 0; i < PublishPortCount; ++i)
+    {
+      HLDS::PublishPolicy policy;
+      if (!HLDS::parsePublishPolicy(*policies[i], policy))
+        {
+          RTC_WARN(("Unknown %s: %s, all is used",
+                    publish_params[i], policies[i]->c_str()));
+        }
+      m_publishGate[i].setPolicy(policy);
+    }
+  m_publishDirty = false;
+}
+
+bool RobotisLDSensor::admit(PublishPort port, RTC::OutPortBase& out)
+{
+  HLDS::PublishGate& gate(m_publishGate[port]);
+  return gate.admit(HLDS::monotonicNow(),
+                    gate.coalescing() && consumerBusy(out));
+}
+
+bool RobotisLDSensor::consumerBusy(RTC::OutPortBase& port)
+{
+  // Data left in a connector buffer has not been taken by the publisher
+  // thread of a push connector or by the consumer of a pull connector.
+  // Synchronous push connectors never leave data behind.
+  const std::vector<RTC::OutPortConnector*>& connectors(port.connectors());
+  for (size_t i = 0; i < connectors.size(); ++i)
+    {
+      RTC::CdrBufferBase* buffer = connectors[i]->getBuffer();
+      if (buffer != NULL && !buffer->empty()) { return true; }
+    }
+  return false;
+}
+
+std::vector<std::string> RobotisLDSensor::latencyReport() const
+{
+  struct Stage { const char* name; HLDS::LatencySummary summary; };
+  const Stage stages[] = {
+    { "frame", m_ldsensor->frameLatency() },
+    { "handoff", m_handoffLatency.summary() },
+    { "decode", m_decodeLatency.summary() },
+    { "filter", m_filterLatency.summary() },
+    { "points", m_pointLatency.summary() },
+    { "bins", m_binLatency.summary() },
+    { "grid", m_gridLatency.summary() },
+    { "odometry", m_odometryLatency.summary() },
+    { "compact", m_compactLatency.summary() },
+    { "shared", m_sharedLatency.summary() },
+    { "publish", m_publishLatency.summary() },
+    { "total", m_totalLatency.summary() },
+    { "jitter", m_ldsensor->packetJitter() }
+  };
+  std::vector<std::string> report;
+  for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); ++i)
+    {
+      const HLDS::LatencySummary& s(stages[i].summary);
+      char line[128];
+      snprintf(line, sizeof(line),
+               "Latency %-8s p50 %9.3f ms, p99 %9.3f ms, max %9.3f ms (%llu)",
+               stages[i].name, s.p50 / 1e6, s.p99 / 1e6, s.max / 1e6,
+               (unsigned long long)s.count);
+      report.push_back(line);
+    }
+  return report;
+}
+
+void PlanListener::operator()(const char* config_set_name,
+                              const char* config_param_name)
+{
+  for (const char* const* name = m_names; *name != NULL; ++name)
+    {
+      if (strcmp(config_param_name, *name) == 0)
+        {
+          m_dirty = true;
+          return;
+        }
+    }
+}
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onAborting(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onError(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+RTC::ReturnCode_t RobotisLDSensor::onReset(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onStateUpdate(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+/*
+RTC::ReturnCode_t RobotisLDSensor::onRateChanged(RTC::UniqueId ec_id)
+{
+  return RTC::RTC_OK;
+}
+*/
+
+
+
+extern "C"
+{
+
+  void RobotisLDSensorInit(RTC::Manager* manager)
+  {
+    coil::Properties profile(robotisldsensor_spec);
+    manager->registerFactory(profile,
+                             RTC::Create<RobotisLDSensor>,
+                             RTC::Delete<RobotisLDSensor>);
+  }
+
+};
+
+
@@ -0,0 +1,293 @@
+// -*- C++ -*-
+/*!
+ * @file RobotisLDSensorSim.cpp
+ * @brief LDS-01 simulator on a pseudo terminal
+ * @date $Date$
+ *
+ * $Id$
+ *
+ * Creates a pseudo terminal that behaves like an LDS-01 on a USB serial
+ * adapter: "b" starts the motor and the stream of 42 byte packets, "e"
+ * stops it. Point the component's port_name at the printed device (or
+ * the --link path) to run it end to end without the sensor.
+ */
+
+#include <HLDS_LDDecode.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+namespace
+{
+volatile sig_atomic_t g_quit = 0;
+
+void onSignal(int)
+{
+  g_quit = 1;
+}
+
+struct Options
+{
+  double rpm;
+  // Standard deviation of the range noise [mm]
+  double noise;
+  // Probability of a byte being dropped
+  double drop;
+  // Probability of a packet being corrupted
+  double corrupt;
+  std::string link;
+};
+
+void usage(const char* name)
+{
+  std::cerr << "usage: " << name << " [options]" << std::endl
+            << "  -r, --rpm RPM        rotation speed (default 300)" << std::endl
+            << "  -n, --noise MM       range noise std. deviation (default 0)" << std::endl
+            << "  -d, --drop P         byte drop probability (default 0)" << std::endl
+            << "  -c, --corrupt P      packet corruption probability (default 0)" << std::endl
+            << "  -l, --link PATH      symlink to the pseudo terminal" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& opt)
+{
+  static const struct option longopts[] = {
+    { "rpm", required_argument, NULL, 'r' },
+    { "noise", required_argument, NULL, 'n' },
+    { "drop", required_argument, NULL, 'd' },
+    { "corrupt", required_argument, NULL, 'c' },
+    { "link", required_argument, NULL, 'l' },
+    { "help", no_argument, NULL, 'h' },
+    { NULL, 0, NULL, 0 }
+  };
+  opt.rpm = 300.0;
+  opt.noise = 0.0;
+  opt.drop = 0.0;
+  opt.corrupt = 0.0;
+
+  int c;
+  while ((c = getopt_long(argc, argv, "r:n:d:c:l:h", longopts, NULL)) != -1)
+    {
+      switch (c)
+        {
+        case 'r': opt.rpm = atof(optarg); break;
+        case 'n': opt.noise = atof(optarg); break;
+        case 'd': opt.drop = atof(optarg); break;
+        case 'c': opt.corrupt = atof(optarg); break;
+        case 'l': opt.link = optarg; break;
+        default: return false;
+        }
+    }
+  return opt.rpm > 0.0 && opt.noise >= 0.0 &&
+    opt.drop >= 0.0 && opt.drop <= 1.0 &&
+    opt.corrupt >= 0.0 && opt.corrupt <= 1.0;
+}
+
+/*
+ * The simulated room: a 4 m x 3 m rectangle with the sensor 0.5 m off
+ * its centre and a 0.3 m radius pillar, seen in the sensor frame with
+ * the beam angle counter-clockwise from the x axis.
+ */
+double rangeAt(double angle)
+{
+  const double xmin = -1.5, xmax = 2.5, ymin = -1.5, ymax = 1.5;
+  const double px = 1.0, py = 0.8, pr = 0.3;
+  double dx = cos(angle), dy = sin(angle);
+
+  double range = 1e9;
+  if (dx > 0) { range = std::min(range, xmax / dx); }
+  if (dx < 0) { range = std::min(range, xmin / dx); }
+  if (dy > 0) { range = std::min(range, ymax / dy); }
+  if (dy < 0) { range = std::min(range, ymin / dy); }
+
+  // Ray / circle intersection, nearest hit in front of the sensor
+  double b = dx * px + dy * py;
+  double disc = b * b - (px * px + py * py - pr * pr);
+  if (disc >= 0 && b - sqrt(disc) > 0)
+    {
+      range = std::min(range, b - sqrt(disc));
+    }
+  return range;
+}
+
+class Simulator
+{
+public:
+  Simulator(const Options& opt, int master)
+    : m_opt(opt), m_master(master), m_random(std::random_device()()),
+      m_noise(0.0, opt.noise > 0.0 ? opt.noise : 1.0), m_unit(0.0, 1.0),
+      m_running(false), m_index(0)
+  {
+  }
+
+  // Serve commands and packets until interrupted
+  void run()
+  {
+    typedef std::chrono::steady_clock clock;
+    // One packet every 6 degrees
+    const std::chrono::nanoseconds period(
+      int64_t(60e9 / m_opt.rpm / HLDS::PacketCount));
+    clock::time_point due = clock::now();
+
+    while (!g_quit)
+      {
+        int timeout = -1;
+        if (m_running)
+          {
+            clock::duration wait = due - clock::now();
+            timeout = std::max(0, int(std::chrono::duration_cast<
+                                      std::chrono::milliseconds>(wait).count()));
+          }
+        struct pollfd pfd = { m_master, POLLIN, 0 };
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0 && errno != EINTR) { perror("poll"); return; }
+        if (ready > 0 && (pfd.revents & POLLIN)) { command(due); }
+
+        while (m_running && clock::now() >= due)
+          {
+            sendPacket();
+            due += period;
+          }
+      }
+  }
+
+private:
+  void command(std::chrono::steady_clock::time_point& due)
+  {
+    char buf[64];
+    ssize_t n = read(m_master, buf, sizeof(buf));
+    for (ssize_t i = 0; i < n; ++i)
+      {
+        if (buf[i] == 'b' && !m_running)
+          {
+            std::cerr << "motor start" << std::endl;
+            m_running = true;
+            m_index = 0;
+            due = std::chrono::steady_clock::now();
+          }
+        else if (buf[i] == 'e' && m_running)
+          {
+            std::cerr << "motor stop" << std::endl;
+            m_running = false;
+          }
+      }
+  }
+
+  void sendPacket()
+  {
+    uint8_t packet[HLDS::PacketLength];
+    uint16_t speed = uint16_t(m_opt.rpm * 10);
+    packet[0] = 0xFA;
+    packet[1] = uint8_t(0xA0 + m_index);
+    packet[2] = uint8_t(speed);
+    packet[3] = uint8_t(speed >> 8);
+    for (uint16_t k = 0; k < HLDS::BeamsPerPacket; ++k)
+      {
+        // Sample k of packet n is beam 359 - (6n + k)
+        int beam = HLDS::BeamCount - 1 - (HLDS::BeamsPerPacket * m_index + k);
+        double mm = rangeAt(beam * M_PI / 180.0) * 1000.0;
+        if (m_opt.noise > 0.0) { mm += m_noise(m_random); }
+        // Out of range readings are reported as 0
+        uint16_t range = (mm < 120.0 || mm > 3500.0) ? 0 : uint16_t(mm);
+        uint16_t intensity = range == 0 ? 0 : uint16_t(3.0e6 / mm);
+        uint8_t* s = packet + 4 + 6 * k;
+        s[0] = uint8_t(intensity);
+        s[1] = uint8_t(intensity >> 8);
+        s[2] = uint8_t(range);
+        s[3] = uint8_t(range >> 8);
+        s[4] = 0;
+        s[5] = 0;
+      }
+    HLDS::writeChecksum(packet);
+    if (m_unit(m_random) < m_opt.corrupt)
+      {
+        packet[2 + int(m_unit(m_random) * 38)] ^= 0x5A;
+      }
+    m_index = (m_index + 1) % HLDS::PacketCount;
+
+    uint8_t out[HLDS::PacketLength];
+    size_t length = 0;
+    for (size_t i = 0; i < sizeof(packet); ++i)
+      {
+        if (m_opt.drop > 0.0 && m_unit(m_random) < m_opt.drop) { continue; }
+        out[length++] = packet[i];
+      }
+    // The master is non-blocking: a client that stops reading loses
+    // data, as with the real sensor
+    if (write(m_master, out, length) < 0 && errno != EAGAIN && errno != EIO)
+      {
+        perror("write");
+      }
+  }
+
+  Options m_opt;
+  int m_master;
+  std::mt19937 m_random;
+  std::normal_distribution<double> m_noise;
+  std::uniform_real_distribution<double> m_unit;
+  bool m_running;
+  uint16_t m_index;
+};
+}
+
+int main (int argc, char** argv)
+{
+  Options opt;
+  if (!parseOptions(argc, argv, opt))
+    {
+      usage(argv[0]);
+      return 1;
+    }
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+      perror("posix_openpt");
+      return 1;
+    }
+  std::string slave(ptsname(master));
+
+  // Raw mode without echo, kept by holding the slave side open
+  int keep = open(slave.c_str(), O_RDWR | O_NOCTTY);
+  struct termios tio;
+  if (keep < 0 || tcgetattr(keep, &tio) != 0)
+    {
+      perror(slave.c_str());
+      return 1;
+    }
+  cfmakeraw(&tio);
+  tcsetattr(keep, TCSANOW, &tio);
+
+  if (!opt.link.empty())
+    {
+      unlink(opt.link.c_str());
+      if (symlink(slave.c_str(), opt.link.c_str()) != 0)
+        {
+          perror(opt.link.c_str());
+          return 1;
+        }
+    }
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  std::cout << (opt.link.empty() ? slave : opt.link) << std::endl;
+  Simulator sim(opt, master);
+  sim.run();
+
+  if (!opt.link.empty()) { unlink(opt.link.c_str()); }
+  close(keep);
+  close(master);
+  return 0;
+}
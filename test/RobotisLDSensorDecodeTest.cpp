@@ -0,0 +1,273 @@
+// -*- C++ -*-
+/*!
+ * @file RobotisLDSensorDecodeTest.cpp
+ * @brief Bit exact test of the frame decoding kernels
+ * @author Noriaki Ando <n-ando@aist.go.jp>
+ *
+ * Copyright (C) 2021, Noriaki Ando http://github.com/n-ando
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Usage: RobotisLDSensorDecodeTest [capture file]
+ *
+ * Runs every frame decoding kernel compiled in and supported by this CPU
+ * against the scalar decoder and checksum and fails on the first result
+ * that is not bit exact:
+ *   recorded:   the revolutions of a capture file, invalid packets
+ *               included
+ *   random:     frames of random bytes with random valid masks, both
+ *               with and without correct headers and checksums
+ * Every frame is decoded at several rotations, at the wrapping packet of
+ * every alignment, and at several scale factors, as float and double,
+ * with and without intensities. The kernel picked by decodeFrame() must
+ * be the fastest one available, i.e. none failed its self check.
+ */
+
+#include <HLDS_Capture.h>
+#include <HLDS_LDDecode.h>
+#include <HLDS_LDFramer.h>
+#include "HLDS_LDDecodeKernels.h"
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+
+namespace
+{
+
+const size_t RandomFrames = 500;
+
+class Random
+{
+public:
+    explicit Random(uint32_t seed) : m_seed(seed) {}
+    uint32_t next()
+    {
+        m_seed = m_seed * 1664525 + 1013904223;
+        return m_seed;
+    }
+    uint8_t byte() { return uint8_t(next() >> 24); }
+
+private:
+    uint32_t m_seed;
+};
+
+uint16_t sentChecksum(const uint8_t* packet)
+{
+    return uint16_t(packet[HLDS::PacketLength - 2] |
+                    (packet[HLDS::PacketLength - 1] << 8));
+}
+
+// Valid mask of a frame as the scalar code computes it
+uint64_t scalarValid(const uint8_t* bytes)
+{
+    uint64_t valid = 0;
+    for (uint16_t n = 0; n < HLDS::PacketCount; ++n)
+    {
+        const uint8_t* packet = bytes + n * HLDS::PacketLength;
+        if (HLDS::validateHeader(packet, n) &&
+            HLDS::kernels::checksumScalar(packet) == sentChecksum(packet))
+        {
+            valid |= uint64_t(1) << n;
+        }
+    }
+    return valid;
+}
+
+// The complete revolutions of a capture file, framed as LDSensor does
+void loadCapture(const char* path, std::vector<HLDS::RawFrame>& frames)
+{
+    HLDS::ReplaySource replay(path, 0.0);
+    HLDS::LDFramer framer;
+    HLDS::RawFrame frame;
+    memset(&frame, 0, sizeof(frame));
+    for (;;)
+    {
+        size_t length = replay.read(framer.writePtr(), framer.writeSpace());
+        if (length == 0) { break; }
+        framer.commit(length);
+        int n;
+        while ((n = framer.nextPacket(frame.bytes)) >= 0)
+        {
+            if (n == HLDS::PacketCount - 1)
+            {
+                frame.valid = scalarValid(frame.bytes);
+                frames.push_back(frame);
+            }
+        }
+    }
+}
+
+void randomFrames(std::vector<HLDS::RawFrame>& frames)
+{
+    Random random(0x9E3779B9);
+    for (size_t f = 0; f < RandomFrames; ++f)
+    {
+        HLDS::RawFrame frame;
+        for (uint16_t i = 0; i < HLDS::FrameLength; ++i)
+        {
+            frame.bytes[i] = random.byte();
+        }
+        if (f % 2 == 0)
+        {
+            for (uint16_t n = 0; n < HLDS::PacketCount; ++n)
+            {
+                uint8_t* packet = frame.bytes + n * HLDS::PacketLength;
+                packet[0] = 0xFA;
+                packet[1] = uint8_t(0xA0 + n);
+                HLDS::writeChecksum(packet);
+            }
+        }
+        frame.valid = (uint64_t(random.next()) << 32 | random.next()) &
+            ((uint64_t(1) << HLDS::PacketCount) - 1);
+        frames.push_back(frame);
+    }
+}
+
+template <typename T>
+bool sameDecode(void (*decode)(const HLDS::RawFrame&,
+                               const HLDS::ScanSpan<T>&),
+                const HLDS::RawFrame& frame, size_t shift, double scale,
+                bool intensities)
+{
+    T expected[2][HLDS::BeamCount];
+    T actual[2][HLDS::BeamCount];
+    memset(expected, 0, sizeof(expected));
+    memset(actual, 0, sizeof(actual));
+    HLDS::ScanSpan<T> e = { expected[0], intensities ? expected[1] : NULL,
+                            scale, shift };
+    HLDS::ScanSpan<T> a = { actual[0], intensities ? actual[1] : NULL,
+                            scale, shift };
+    HLDS::decodeFrameScalar(frame, e);
+    decode(frame, a);
+    return memcmp(expected, actual, sizeof(expected)) == 0;
+}
+
+/*
+ * Compares a kernel set with the scalar code on every frame
+ * @return Number of mismatches, the first few are reported
+ */
+size_t check(const HLDS::kernels::KernelSet& kernel,
+             const std::vector<HLDS::RawFrame>& frames, const char* input)
+{
+    const double scales[] = { 1.0, 0.001, 3.3, 1000.0 };
+    Random random(0x2545F491);
+    size_t failures = 0;
+    for (size_t f = 0; f < frames.size(); ++f)
+    {
+        const HLDS::RawFrame& frame = frames[f];
+        for (uint16_t n = 0; n < HLDS::PacketCount; ++n)
+        {
+            const uint8_t* packet = frame.bytes + n * HLDS::PacketLength;
+            if (kernel.checksum(packet) !=
+                HLDS::kernels::checksumScalar(packet) && failures++ < 10)
+            {
+                std::cerr << kernel.name << ": " << input << " frame " << f
+                          << " packet " << n << ": checksum differs"
+                          << std::endl;
+            }
+        }
+        // Every alignment of the wrapping packet, half a turn and a
+        // random rotation
+        size_t shifts[HLDS::BeamsPerPacket + 2];
+        for (size_t i = 0; i < HLDS::BeamsPerPacket; ++i) { shifts[i] = i; }
+        shifts[HLDS::BeamsPerPacket] = HLDS::BeamCount / 2;
+        shifts[HLDS::BeamsPerPacket + 1] = random.next() % HLDS::BeamCount;
+        for (size_t i = 0; i < sizeof(shifts) / sizeof(shifts[0]); ++i)
+        {
+            for (size_t j = 0; j < sizeof(scales) / sizeof(scales[0]); ++j)
+            {
+                bool intensities = (i + j) % 2 == 0;
+                if ((!sameDecode<float>(kernel.decodeFloat, frame,
+                                        shifts[i], scales[j], intensities) ||
+                     !sameDecode<double>(kernel.decodeDouble, frame,
+                                         shifts[i], scales[j], intensities))
+                    && failures++ < 10)
+                {
+                    std::cerr << kernel.name << ": " << input << " frame "
+                              << f << " shift " << shifts[i] << " scale "
+                              << scales[j] << ": decoding differs"
+                              << std::endl;
+                }
+            }
+        }
+    }
+    return failures;
+}
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<HLDS::RawFrame> recorded;
+    std::vector<HLDS::RawFrame> random;
+    if (argc > 1)
+    {
+        try
+        {
+            loadCapture(argv[1], recorded);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (recorded.empty())
+        {
+            std::cerr << argv[1] << ": no complete revolution" << std::endl;
+            return 1;
+        }
+    }
+    randomFrames(random);
+
+    HLDS::kernels::KernelSet kernels[HLDS::kernels::MaxKernels];
+    size_t count = HLDS::kernels::availableKernels(kernels);
+    size_t failures = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t failed = check(kernels[i], recorded, "recorded") +
+            check(kernels[i], random, "random");
+        if (!HLDS::kernels::verify(kernels[i]))
+        {
+            std::cerr << kernels[i].name << ": self check failed"
+                      << std::endl;
+            ++failed;
+        }
+        std::cout << kernels[i].name << ": " << recorded.size()
+                  << " recorded and " << random.size() << " random frames, "
+                  << (failed == 0 ? "ok" : "FAILED") << std::endl;
+        failures += failed;
+    }
+
+    if (strcmp(HLDS::decodeKernel(), kernels[0].name) != 0)
+    {
+        std::cerr << "decodeFrame() runs " << HLDS::decodeKernel()
+                  << " instead of " << kernels[0].name << std::endl;
+        ++failures;
+    }
+    return failures == 0 ? 0 : 1;
+}